@@ -14,6 +14,7 @@
 #ifndef __BOARD_LINK__
 #define __BOARD_LINK__
 
+#include "i2c_frame.h"
 #include "simple_i2c_controller.h"
 
 /******************************** MACRO DEFINITIONS ********************************/
@@ -21,6 +22,40 @@
 #define COMPONENT_ADDR_MASK 0x000000FF             
 #define SUCCESS_RETURN 0
 #define ERROR_RETURN -1
+#define NOT_READY_RETURN -2
+// Deliver packets with a single RECEIVE_FRAME write. Set to 0 to use the
+// three-step RECEIVE_LEN, RECEIVE, RECEIVE_DONE sequence instead
+#define BOARD_LINK_FRAMED_WRITES 1
+// Commands that may be outstanding to one component, matches the
+// mailbox depth of the component
+#define BOARD_LINK_MAILBOX_DEPTH 4
+// Payload bytes fetched speculatively with every TRANSMIT_FRAME poll
+// Replies up to this size are received in the poll itself
+#define BOARD_LINK_PREFETCH_LEN I2C_FRAME_INLINE_LEN
+
+// Adaptive polling: the first poll is scheduled at POLL_LEAD_NUM/POLL_LEAD_DEN
+// of the learned response time, later polls back off exponentially
+#define POLL_LEAD_NUM 7
+#define POLL_LEAD_DEN 8
+#define POLL_MIN_BACKOFF_US 20
+#define POLL_MAX_BACKOFF_US 2000
+// Give-up time for replies to boot-time commands. Post-boot traffic
+// waits with POLL_NO_TIMEOUT for as long as the component needs
+#define POLL_TIMEOUT_US 2000000
+#define POLL_NO_TIMEOUT 0
+// Weight of a new response time sample as a shift, 3 -> 1/8
+#define POLL_EWMA_SHIFT 3
+
+/******************************** TYPE DEFINITIONS ********************************/
+// State of one outstanding poll for a reply
+typedef struct {
+    i2c_addr_t address;
+    uint32_t start;
+    uint32_t next_poll_us;
+    uint32_t backoff_us;
+    uint32_t timeout_us;
+    bool learn;
+} poll_state_t;
 
 /******************************** FUNCTION PROTOTYPES ********************************/
 /**
@@ -39,6 +74,20 @@ void board_link_init(void);
 */
 i2c_addr_t component_id_to_i2c_addr(uint32_t component_id);
 
+/**
+ * @brief Probe a set of I2C addresses for an ACK
+ * 
+ * @param addrs: i2c_addr_t*, addresses to probe
+ * @param count: int, number of addresses
+ * @param acked: bool*, set per address to true if the address ACKed
+ * 
+ * @return status: SUCCESS_RETURN if success, ERROR_RETURN if error
+ *
+ * Probes are pipelined through the asynchronous I2C engine with one
+ * zero-length write per address
+*/
+int probe_addresses(i2c_addr_t* addrs, int count, bool* acked);
+
 /**
  * @brief Send an arbitrary packet over I2C
  * 
@@ -47,18 +96,109 @@ i2c_addr_t component_id_to_i2c_addr(uint32_t component_id);
  * @param packet: uint8_t*, pointer to packet to be sent
  * 
  * @return status: SUCCESS_RETURN if success, ERROR_RETURN if error
- * Function sends an arbitrary packet over i2c to a specified component
+ * Function sends an arbitrary packet over i2c to a specified component.
+ * Up to BOARD_LINK_MAILBOX_DEPTH packets may be sent to a component
+ * before its replies are received
+*/
+RAMFUNC int send_packet(i2c_addr_t address, uint8_t len, uint8_t* packet);
+
+/**
+ * @brief Send a packet gathered from separate buffers over I2C
+ * 
+ * @param address: i2c_addr_t, i2c address
+ * @param iov: const i2c_iovec_t*, segments of the packet in order
+ * @param count: unsigned int, number of segments, at most I2C_IOV_MAX
+ * 
+ * @return status: SUCCESS_RETURN if success, ERROR_RETURN if error
+ *
+ * As send_packet, but the header, opcode, payload and tag of a message
+ * can stay in their own buffers. Large segments are sent in place
+*/
+RAMFUNC int send_packetv(i2c_addr_t address, const i2c_iovec_t* iov, unsigned int count);
+
+/**
+ * @brief Receive a packet if a component has one ready
+ * 
+ * @param address: i2c_addr_t, i2c address
+ * @param packet: uint8_t*, pointer to a buffer where a packet will be received 
+ * 
+ * @return int: size of data received, NOT_READY_RETURN if no packet is
+ *   ready yet, ERROR_RETURN if error
+ *
+ * A single TRANSMIT_FRAME read returns the done flag, the sequence, the
+ * length and the first BOARD_LINK_PREFETCH_LEN bytes of the payload.
+ * Longer payloads are completed with one read of TRANSMIT. Replies are
+ * returned in the order the packets were sent. On error every command
+ * outstanding to the address is given up
+*/
+RAMFUNC int try_receive_packet(i2c_addr_t address, uint8_t* packet);
+
+/**
+ * @brief Start waiting for a reply from a component
+ * 
+ * @param address: i2c_addr_t, i2c address
+ * @param timeout_us: uint32_t, give up after this long, POLL_NO_TIMEOUT to wait forever
+ * @param state: poll_state_t*, poll state to initialize
+ *
+ * Schedules the first poll just before the response time learned for the
+ * address. Call right after the command has been sent
+*/
+void poll_begin(i2c_addr_t address, uint32_t timeout_us, poll_state_t* state);
+
+/**
+ * @brief Start waiting for a reply that is ready right away
+ * 
+ * @param address: i2c_addr_t, i2c address
+ * @param timeout_us: uint32_t, give up after this long, POLL_NO_TIMEOUT to wait forever
+ * @param state: poll_state_t*, poll state to initialize
+ *
+ * For commands the component answers from its I2C interrupt. The first
+ * poll is due immediately and the response time is not learned from it
+*/
+void poll_begin_immediate(i2c_addr_t address, uint32_t timeout_us, poll_state_t* state);
+
+/**
+ * @brief Time until the next scheduled poll
+ * 
+ * @param state: poll_state_t*, poll state
+ * 
+ * @return uint32_t: microseconds until the next poll is due, 0 if due now
+*/
+uint32_t poll_wait_us(poll_state_t* state);
+
+/**
+ * @brief Poll for a reply if a poll is due
+ * 
+ * @param state: poll_state_t*, poll state
+ * @param packet: uint8_t*, pointer to a buffer where a packet will be received 
+ * 
+ * @return int: size of data received, NOT_READY_RETURN if the poll is not
+ *   due or the reply is not ready, ERROR_RETURN if error or timeout
+ *
+ * On success the measured response time is folded into the per-address
+ * average, otherwise the next poll is backed off exponentially
+*/
+RAMFUNC int poll_receive_packet(poll_state_t* state, uint8_t* packet);
+
+/**
+ * @brief Wait for a reply started with poll_begin
+ * 
+ * @param state: poll_state_t*, poll state
+ * @param packet: uint8_t*, pointer to a buffer where a packet will be received 
+ * 
+ * @return int: size of data received, ERROR_RETURN if error
 */
-int send_packet(i2c_addr_t address, uint8_t len, uint8_t* packet);
+RAMFUNC int poll_wait_and_receive_packet(poll_state_t* state, uint8_t* packet);
 
 /**
  * @brief Poll a component and receive a packet
  * 
  * @param address: i2c_addr_t, i2c address
+ * @param timeout_us: uint32_t, give up after this long, POLL_NO_TIMEOUT to wait forever
  * @param packet: uint8_t*, pointer to a buffer where a packet will be received 
  * 
  * @return int: size of data received, ERROR_RETURN if error
 */
-int poll_and_receive_packet(i2c_addr_t address, uint8_t* packet);
+int poll_and_receive_packet(i2c_addr_t address, uint32_t timeout_us, uint8_t* packet);
 
 #endif
@@ -18,24 +18,65 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/******************************** MACRO DEFINITIONS ********************************/
+// Stream console output from a ring buffer by DMA. Output is only waited
+// for at prompts and at the end of a command
+// Set to 0 to write every message to the UART before returning
+#define HOST_DMA_MODE 1
+// Bytes of console output that can be queued, must be a power of two
+#define HOST_TX_RING_SIZE 1024
+// Longest formatted message body queued without going through stdio
+#define HOST_LINE_MAX 320
+
 // Macro definitions to print the specified format for error messages
-#define print_error(...) printf("%%error: "); printf(__VA_ARGS__); printf("%%"); fflush(stdout)
-#define print_hex_error(...) printf("%%error: "); print_hex(__VA_ARGS__); printf("%%"); fflush(stdout)
+#define print_error(...) host_print("error", __VA_ARGS__)
+#define print_hex_error(...) host_print_hex("error", __VA_ARGS__)
 
 // Macro definitions to print the specified format for success messages
-#define print_success(...) printf("%%success: "); printf(__VA_ARGS__); printf("%%"); fflush(stdout)
-#define print_hex_success(...) printf("%%success: "); print_hex(__VA_ARGS__); printf("%%"); fflush(stdout)
+#define print_success(...) host_print("success", __VA_ARGS__)
+#define print_hex_success(...) host_print_hex("success", __VA_ARGS__)
 
 // Macro definitions to print the specified format for debug messages
-#define print_debug(...) printf("%%debug: "); printf(__VA_ARGS__); printf("%%"); fflush(stdout)
-#define print_hex_debug(...) printf("%%debug: "); print_hex(__VA_ARGS__); printf("%%"); fflush(stdout)
+#define print_debug(...) host_print("debug", __VA_ARGS__)
+#define print_hex_debug(...) host_print_hex("debug", __VA_ARGS__)
 
 // Macro definitions to print the specified format for info messages
-#define print_info(...) printf("%%info: "); printf(__VA_ARGS__); printf("%%"); fflush(stdout)
-#define print_hex_info(...) printf("%%info: "); print_hex(__VA_ARGS__); printf("%%"); fflush(stdout)
+#define print_info(...) host_print("info", __VA_ARGS__)
+#define print_hex_info(...) host_print_hex("info", __VA_ARGS__)
 
 // Macro definitions to print the specified format for ack messages
-#define print_ack() printf("%%ack%%\n"); fflush(stdout)
+#define print_ack() host_ack()
+
+/******************************** TYPE DEFINITIONS ********************************/
+// Console output accounting returned by host_messaging_stats
+typedef struct {
+    uint32_t queued;
+    uint32_t flushes;
+    uint32_t stalls;
+} host_stats_t;
+
+/******************************** FUNCTION PROTOTYPES ********************************/
+// Start streaming console output by DMA. Output queued before this
+// call is written to the UART before returning from each message
+void host_messaging_init(void);
+
+// Queue raw bytes for the console
+void host_write(const char *data, size_t len);
+
+// Wait until every queued byte has left the UART
+void host_flush(void);
+
+// Queue a message of the given type, as "%type: message%"
+void host_print(const char *type, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Queue a buffer of bytes as a hex string message of the given type
+void host_print_hex(const char *type, uint8_t *buf, size_t len);
+
+// Send the ack prompt and wait for it to leave the UART
+void host_ack(void);
+
+// Get the console output accounting
+const host_stats_t* host_messaging_stats(void);
 
 // Print a message through USB UART and then receive a line over USB UART
 void recv_input(const char *msg, char *buf);
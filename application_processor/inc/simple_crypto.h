@@ -22,6 +22,58 @@
 #define BLOCK_SIZE AES_BLOCK_SIZE
 #define KEY_SIZE 16
 #define HASH_SIZE MD5_DIGEST_SIZE
+// Largest digest of any hash_alg_t
+#define HASH_MAX_SIZE WC_SHA256_DIGEST_SIZE
+// Nonce and tag lengths of the GCM calls
+#define GCM_IV_SIZE 12
+#define GCM_TAG_SIZE 16
+// Run the context calls on the MAX78000 AES engine. Set to 0, e.g. with
+// -DCRYPTO_AES_HW=0, to use the wolfSSL software implementation behind
+// the same API
+#ifndef CRYPTO_AES_HW
+#define CRYPTO_AES_HW 1
+#endif
+
+/******************************** TYPE DEFINITIONS ********************************/
+/** Expanded key schedules for one symmetric key
+ *
+ * Owned by the caller and set up once with sym_ctx_init, so messages
+ * under a long-lived key skip key expansion. In software AES needs a
+ * separate schedule for each direction, the encrypt schedule also
+ * carries the GCM tables. The AES engine expands the key itself, so
+ * only the key and a 4-bit GHASH table of the subkey are kept. gcm_hh and
+ * gcm_hl hold the high and low halves of each nibble multiple of the subkey
+ */
+typedef struct {
+#if CRYPTO_AES_HW
+    uint8_t key[KEY_SIZE];
+    uint64_t gcm_hh[16];
+    uint64_t gcm_hl[16];
+#else
+    Aes encrypt;
+    Aes decrypt;
+#endif
+} sym_ctx_t;
+
+/** Hash algorithms offered by the hash context calls */
+typedef enum {
+    HASH_MD5,
+    HASH_SHA256,
+} hash_alg_t;
+
+/** Incremental hash state
+ *
+ * Set up once with hash_ctx_init, fed with any number of
+ * hash_ctx_update calls and finished with hash_ctx_final, which leaves
+ * the state ready for the next digest
+ */
+typedef struct {
+    hash_alg_t alg;
+    union {
+        wc_Md5 md5;
+        wc_Sha256 sha256;
+    };
+} hash_ctx_t;
 
 /******************************** FUNCTION PROTOTYPES ********************************/
 /** @brief Encrypts plaintext using a symmetric cipher
@@ -39,6 +91,37 @@
  */
 int encrypt_sym(uint8_t *plaintext, size_t len, uint8_t *key, uint8_t *ciphertext);
 
+/** @brief Expands a symmetric key into a context
+ *
+ * @param ctx A pointer to the context to set up
+ * @param key A pointer to a buffer of length KEY_SIZE (16 bytes) containing
+ *          the key
+ *
+ * @return 0 on success, non-zero for other error
+ */
+int sym_ctx_init(sym_ctx_t *ctx, uint8_t *key);
+
+/** @brief Releases a context set up by sym_ctx_init
+ *
+ * @param ctx A pointer to the context to release. The key schedules
+ *          are cleared
+ */
+void sym_ctx_free(sym_ctx_t *ctx);
+
+/** @brief Encrypts plaintext using the key of a context
+ *
+ * @param ctx A pointer to a context set up by sym_ctx_init
+ * @param plaintext A pointer to a buffer of length len containing the
+ *          plaintext to encrypt
+ * @param len The length of the plaintext to encrypt. Must be a multiple of
+ *          BLOCK_SIZE (16 bytes)
+ * @param ciphertext A pointer to a buffer of length len where the resulting
+ *          ciphertext will be written to
+ *
+ * @return 0 on success, -1 on bad length, other non-zero for other error
+ */
+int encrypt_sym_ctx(sym_ctx_t *ctx, uint8_t *plaintext, size_t len, uint8_t *ciphertext);
+
 /** @brief Decrypts ciphertext using a symmetric cipher
  *
  * @param ciphertext A pointer to a buffer of length len containing the
@@ -54,6 +137,77 @@ int encrypt_sym(uint8_t *plaintext, size_t len, uint8_t *key, uint8_t *ciphertex
  */
 int decrypt_sym(uint8_t *ciphertext, size_t len, uint8_t *key, uint8_t *plaintext);
 
+/** @brief Decrypts ciphertext using the key of a context
+ *
+ * @param ctx A pointer to a context set up by sym_ctx_init
+ * @param ciphertext A pointer to a buffer of length len containing the
+ *           ciphertext to decrypt
+ * @param len The length of the ciphertext to decrypt. Must be a multiple of
+ *           BLOCK_SIZE (16 bytes)
+ * @param plaintext A pointer to a buffer of length len where the resulting
+ *           plaintext will be written to
+ *
+ * @return 0 on success, -1 on bad length, other non-zero for other error
+ */
+int decrypt_sym_ctx(sym_ctx_t *ctx, uint8_t *ciphertext, size_t len, uint8_t *plaintext);
+
+/** @brief Encrypts or decrypts data in counter mode
+ *
+ * @param ctx A pointer to a context set up by sym_ctx_init
+ * @param iv A pointer to a buffer of length BLOCK_SIZE (16 bytes) containing
+ *           the initial counter block. Must never repeat under one key
+ * @param in A pointer to a buffer of length len containing the data
+ * @param len The length of the data, any length
+ * @param out A pointer to a buffer of length len where the result will be
+ *           written to. May be the same as in
+ *
+ * @return 0 on success, non-zero for other error
+ */
+int crypt_ctr(sym_ctx_t *ctx, uint8_t *iv, uint8_t *in, size_t len, uint8_t *out);
+
+/** @brief Encrypts and authenticates plaintext in GCM
+ *
+ * @param ctx A pointer to a context set up by sym_ctx_init
+ * @param iv A pointer to a buffer of length GCM_IV_SIZE (12 bytes) containing
+ *           the nonce. Must never repeat under one key
+ * @param aad A pointer to a buffer of length aad_len containing data that
+ *           is authenticated but not encrypted, may be NULL if aad_len is 0
+ * @param aad_len The length of aad
+ * @param plaintext A pointer to a buffer of length len containing the
+ *           plaintext to encrypt
+ * @param len The length of the plaintext, any length
+ * @param ciphertext A pointer to a buffer of length len where the resulting
+ *           ciphertext will be written to
+ * @param tag A pointer to a buffer of length GCM_TAG_SIZE (16 bytes) where
+ *           the authentication tag will be written to
+ *
+ * @return 0 on success, non-zero for other error
+ */
+int encrypt_gcm(sym_ctx_t *ctx, uint8_t *iv, uint8_t *aad, size_t aad_len,
+                uint8_t *plaintext, size_t len, uint8_t *ciphertext, uint8_t *tag);
+
+/** @brief Authenticates and decrypts ciphertext in GCM
+ *
+ * @param ctx A pointer to a context set up by sym_ctx_init
+ * @param iv A pointer to a buffer of length GCM_IV_SIZE (12 bytes) containing
+ *           the nonce used for encryption
+ * @param aad A pointer to a buffer of length aad_len containing the
+ *           authenticated data, may be NULL if aad_len is 0
+ * @param aad_len The length of aad
+ * @param ciphertext A pointer to a buffer of length len containing the
+ *           ciphertext to decrypt
+ * @param len The length of the ciphertext, any length
+ * @param tag A pointer to a buffer of length GCM_TAG_SIZE (16 bytes) containing
+ *           the authentication tag
+ * @param plaintext A pointer to a buffer of length len where the resulting
+ *           plaintext will be written to. Must be discarded if
+ *           authentication fails
+ *
+ * @return 0 on success, -1 on authentication failure, other non-zero for other error
+ */
+int decrypt_gcm(sym_ctx_t *ctx, uint8_t *iv, uint8_t *aad, size_t aad_len,
+                uint8_t *ciphertext, size_t len, uint8_t *tag, uint8_t *plaintext);
+
 /** @brief Hashes arbitrary-length data
  *
  * @param data A pointer to a buffer of length len containing the data
@@ -66,5 +220,64 @@ int decrypt_sym(uint8_t *ciphertext, size_t len, uint8_t *key, uint8_t *plaintex
  */
 int hash(void *data, size_t len, uint8_t *hash_out);
 
+/** @brief Sets up a hash context
+ *
+ * @param ctx A pointer to the context to set up
+ * @param alg The hash algorithm to use
+ *
+ * @return 0 on success, -1 on unknown algorithm, other non-zero for other error
+ */
+int hash_ctx_init(hash_ctx_t *ctx, hash_alg_t alg);
+
+/** @brief Releases a context set up by hash_ctx_init
+ *
+ * @param ctx A pointer to the context to release
+ */
+void hash_ctx_free(hash_ctx_t *ctx);
+
+/** @brief Digest length of a hash context
+ *
+ * @param ctx A pointer to a context set up by hash_ctx_init
+ *
+ * @return The number of bytes hash_ctx_final writes
+ */
+size_t hash_ctx_size(hash_ctx_t *ctx);
+
+/** @brief Feeds data into a hash context
+ *
+ * @param ctx A pointer to a context set up by hash_ctx_init
+ * @param data A pointer to a buffer of length len containing the next
+ *           part of the message. May point straight into flash
+ * @param len The length of the data
+ *
+ * @return 0 on success, non-zero for other error
+ */
+int hash_ctx_update(hash_ctx_t *ctx, const void *data, size_t len);
+
+/** @brief Finishes the digest of a hash context
+ *
+ * @param ctx A pointer to a context set up by hash_ctx_init
+ * @param hash_out A pointer to a buffer of length hash_ctx_size(ctx) where
+ *           the resulting hash output will be written to
+ *
+ * @return 0 on success, non-zero for other error
+ *
+ * The context is reset and can be reused for the next message
+ */
+int hash_ctx_final(hash_ctx_t *ctx, uint8_t *hash_out);
+
+/** @brief Hashes arbitrary-length data using a context
+ *
+ * @param ctx A pointer to a context set up by hash_ctx_init
+ * @param data A pointer to a buffer of length len containing the data
+ *           to be hashed
+ * @param len The length of the data to hash
+ * @param hash_out A pointer to a buffer of length hash_ctx_size(ctx) where
+ *           the resulting hash output will be written to
+ *
+ * @return 0 on success, non-zero for other error
+ */
+int hash_ctx(hash_ctx_t *ctx, void *data, size_t len, uint8_t *hash_out);
+
 #endif // CRYPTO_EXAMPLE
 #endif // ECTF_CRYPTO_H
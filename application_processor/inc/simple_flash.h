@@ -16,11 +16,32 @@
 
 #include <stdint.h>
 
+/******************************** MACRO DEFINITIONS ********************************/
+// The journal alternates between two consecutive flash pages
+#define FLASH_JOURNAL_PAGES 2
+// Each record fills one 128-bit flash line so it is programmed in one operation
+#define FLASH_JOURNAL_RECORD_SIZE 16
+// Key of the record that marks a page as the live journal
+#define FLASH_JOURNAL_HEADER_KEY 0xFFFF0000
+#define FLASH_JOURNAL_MAGIC 0x4A524E4C
+
+/******************************** TYPE DEFINITIONS ********************************/
+// A single journal record. key is the index of the word it sets, or
+// FLASH_JOURNAL_HEADER_KEY for the page header
+typedef struct {
+    uint32_t seq;
+    uint32_t key;
+    uint32_t value;
+    uint32_t crc;
+} flash_journal_record;
+
+/******************************** FUNCTION PROTOTYPES ********************************/
 /**
  * @brief Initialize the Simple Flash Interface
  * 
  * This function registers the interrupt for the flash system,
- * enables the interrupt, and disables ICC
+ * enables the interrupt, and enables ICC. The cache is only
+ * disabled while a page is erased or written
 */
 void flash_simple_init(void);
 /**
@@ -63,4 +84,52 @@ void flash_simple_read(uint32_t address, uint32_t* buffer, uint32_t size);
 */
 int flash_simple_write(uint32_t address, uint32_t* buffer, uint32_t size);
 
+/**
+ * @brief Open the Flash Journal
+ * 
+ * @param base: uint32_t, address of the first of FLASH_JOURNAL_PAGES pages
+ * @param words: uint32_t*, RAM copy of the journaled words
+ * @param count: uint32_t, number of journaled words
+ * 
+ * @return int: return negative if no journal was found, zero if success
+ *
+ * Replays the live journal page into words. Words the journal never set
+ * are left erased (0xFFFFFFFF). If no journal is found the caller fills in
+ * words and creates one with flash_simple_journal_reset
+*/
+int flash_simple_journal_open(uint32_t base, uint32_t* words, uint32_t count);
+/**
+ * @brief Flash Journal Reset
+ * 
+ * @return int: return negative if failure, zero if success
+ *
+ * Writes a snapshot of every word to the spare page and makes it the
+ * live journal. The header is written last so an interrupted reset
+ * leaves the previous journal in place. The spare page is only erased
+ * here if flash_simple_service has not erased it ahead of time
+*/
+int flash_simple_journal_reset(void);
+/**
+ * @brief Flash Journal Write
+ * 
+ * @param index: uint32_t, index of the word to set
+ * @param value: uint32_t, new value of the word
+ * 
+ * @return int: return negative if failure, zero if success
+ *
+ * Appends a single record to the live page. Only when the page is full is
+ * the journal compacted into the spare page with flash_simple_journal_reset.
+ * The word in RAM is left unchanged on failure
+*/
+int flash_simple_journal_write(uint32_t index, uint32_t value);
+/**
+ * @brief Flash Simple Service
+ *
+ * Erases the spare journal page ahead of time so the next compaction only
+ * has to program it. Call from the main loop while idle: the flash has a
+ * single bank, so instruction fetches stall for the whole erase and it
+ * must not land on the command path
+*/
+void flash_simple_service(void);
+
 #endif
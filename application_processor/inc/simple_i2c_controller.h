@@ -20,21 +20,40 @@
 #include "board.h"
 #include "nvic_table.h"
 #include "i2c.h"
+#include "dma.h"
 #include "string.h"
+#include "ramfunc.h"
 
 /******************************** MACRO DEFINITIONS ********************************/
-// I2C frequency in HZ
+// I2C frequency in HZ used until a component negotiates a faster speed
 #define I2C_FREQ 100000
+// Fastest bus speed the AP will negotiate
+#define I2C_MAX_SPEED I2C_SPEED_FAST_PLUS
+// Transfers per error window and errors within a window that step an address down
+#define I2C_SPEED_WINDOW 32
+#define I2C_SPEED_ERR_THRESHOLD 4
 // Physical I2C interface
 #define I2C_INTERFACE MXC_I2C1
 // Last register for out-of-bounds checking
-#define MAX_REG TRANSMIT_LEN 
+#define MAX_REG TRANSMIT_FRAME
 // Maximum length of an I2C register
 #define MAX_I2C_MESSAGE_LEN 256
+// Number of request descriptors available to the asynchronous engine
+#define I2C_REQ_POOL_SIZE 8
+// Payloads longer than this are moved by DMA instead of the CPU
+#define I2C_DMA_THRESHOLD 32
+// Segments a single write can be gathered from
+#define I2C_IOV_MAX 4
 
 /******************************** TYPE DEFINITIONS ********************************/
 /* ECTF_I2C_REGS
  * Emulated hardware registers for sending and receiving I2C messages
+ * RECEIVE_FRAME takes an ack sequence, a request sequence and a length byte
+ * followed by the payload in one write and queues it as if RECEIVE_LEN,
+ * RECEIVE and RECEIVE_DONE were written. The commit also acknowledges every
+ * queued reply up to and including the ack sequence
+ * TRANSMIT_FRAME reads back TRANSMIT_DONE, the reply sequence, TRANSMIT_LEN
+ * and TRANSMIT of the oldest queued reply in order
 */ 
 typedef enum {
     RECEIVE,
@@ -43,10 +62,94 @@ typedef enum {
     TRANSMIT,
     TRANSMIT_DONE,
     TRANSMIT_LEN,
+    RECEIVE_FRAME,
+    TRANSMIT_FRAME,
 } ECTF_I2C_REGS;
 
 typedef uint8_t i2c_addr_t;
 
+/* I2C_SPEED
+ * Bus speeds a component can advertise in its scan reply
+*/
+typedef enum {
+    I2C_SPEED_STANDARD,
+    I2C_SPEED_FAST,
+    I2C_SPEED_FAST_PLUS,
+    I2C_SPEED_COUNT,
+} i2c_speed_t;
+
+/* I2C_SPEED_STATS
+ * Negotiated speed and error accounting for a single address
+*/
+typedef struct {
+    uint8_t advertised;
+    uint8_t max_speed;
+    uint8_t speed;
+    uint16_t window_transfers;
+    uint16_t window_errors;
+    uint32_t transfers[I2C_SPEED_COUNT];
+    uint32_t errors[I2C_SPEED_COUNT];
+} i2c_speed_stats_t;
+
+/* I2C_IOVEC
+ * One segment of a gathered write. Segments are sent back to back as
+ * if they were a single buffer
+*/
+typedef struct {
+    const uint8_t* buf;
+    uint8_t len;
+} i2c_iovec_t;
+
+/* I2C_COPY_STATS
+ * Payload bytes copied into request descriptors and bytes sent in place
+*/
+typedef struct {
+    uint32_t copies;
+    uint32_t bytes_copied;
+    uint32_t bytes_in_place;
+} i2c_copy_stats_t;
+
+/* I2C_REQ_STATE
+ * Lifecycle of a request descriptor in the asynchronous engine
+*/
+typedef enum {
+    I2C_REQ_FREE,
+    I2C_REQ_PENDING,
+    I2C_REQ_ACTIVE,
+    I2C_REQ_DONE,
+} i2c_req_state_t;
+
+/* I2C_SIMPLE_REQ
+ * Request descriptor taken from the fixed pool of the asynchronous engine
+ * The HAL request must remain the first member so the completion callback
+ * can recover the descriptor from the request pointer
+ * Large writes send the header in tx_buf and then the dma_count segments
+ * of dma_iov in place, dma_len bytes in all, so every segment must stay
+ * valid until completion
+*/
+typedef struct {
+    mxc_i2c_req_t request;
+    volatile i2c_req_state_t state;
+    volatile int result;
+    bool notify;
+    uint8_t speed;
+    uint32_t tag;
+    uint8_t tx_buf[MAX_I2C_MESSAGE_LEN + 1];
+    i2c_iovec_t dma_iov[I2C_IOV_MAX];
+    unsigned int dma_count;
+    unsigned int dma_next;
+    unsigned int dma_len;
+} i2c_simple_req_t;
+
+/* I2C_SIMPLE_COMPLETION
+ * Entry returned from the completion queue for a finished asynchronous request
+*/
+typedef struct {
+    uint32_t tag;
+    i2c_addr_t addr;
+    int result;
+} i2c_simple_completion_t;
+
 /******************************** FUNCTION PROTOTYPES ********************************/
 /**
  * @brief Initialize the I2C Connection
@@ -56,6 +159,126 @@ typedef uint8_t i2c_addr_t;
 */
 int i2c_simple_controller_init(void);
 
+/**
+ * @brief Set the negotiated bus speed for an address
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param speed: i2c_speed_t, fastest speed the device advertised
+ *
+ * Transfers to the address run at the lower of the advertised speed and
+ * I2C_MAX_SPEED. The error window for the address is reset
+*/
+void i2c_simple_set_max_speed(i2c_addr_t addr, i2c_speed_t speed);
+/**
+ * @brief Refresh the advertised bus speed for an address
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param speed: i2c_speed_t, fastest speed the device advertised
+ *
+ * Renegotiates only if the advertised speed changed. Otherwise a speed
+ * stepped down after errors is kept until an error-free window raises it
+*/
+void i2c_simple_refresh_max_speed(i2c_addr_t addr, i2c_speed_t speed);
+/**
+ * @brief Get the speed and error accounting for an address
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * 
+ * @return const i2c_speed_stats_t*: accounting for the address
+*/
+const i2c_speed_stats_t* i2c_simple_get_speed_stats(i2c_addr_t addr);
+/**
+ * @brief Get the payload copy accounting
+ * 
+ * @return const i2c_copy_stats_t*: copies made by every write so far
+*/
+const i2c_copy_stats_t* i2c_simple_get_copy_stats(void);
+/**
+ * @brief Bus frequency of a speed
+ * 
+ * @param speed: i2c_speed_t, bus speed
+ * 
+ * @return unsigned int: frequency in HZ
+*/
+unsigned int i2c_simple_speed_hz(i2c_speed_t speed);
+
+/**
+ * @brief Submit an asynchronous read of a register
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param reg: ECTF_I2C_REGS, register to read from
+ * @param len: uint8_t, length of data to read
+ * @param buf: uint8_t*, buffer to read data into, must stay valid until completion
+ * @param tag: uint32_t, caller value returned with the completion
+ * 
+ * @return int: descriptor index if queued, negative if error
+ *
+ * Queue a read on the asynchronous engine. The result is posted to the
+ * completion queue and must be collected with i2c_simple_complete
+*/
+int i2c_simple_submit_read(i2c_addr_t addr, ECTF_I2C_REGS reg, uint8_t len, uint8_t* buf, uint32_t tag);
+/**
+ * @brief Submit an asynchronous write of a register
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param reg: ECTF_I2C_REGS, register to write to
+ * @param len: uint8_t, length of data to write
+ * @param buf: uint8_t*, buffer to write data from, copied before returning
+ * @param tag: uint32_t, caller value returned with the completion
+ * 
+ * @return int: descriptor index if queued, negative if error
+ *
+ * Queue a write on the asynchronous engine. The result is posted to the
+ * completion queue and must be collected with i2c_simple_complete
+*/
+int i2c_simple_submit_write(i2c_addr_t addr, ECTF_I2C_REGS reg, uint8_t len, uint8_t* buf, uint32_t tag);
+/**
+ * @brief Submit an asynchronous address probe
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param tag: uint32_t, caller value returned with the completion
+ * 
+ * @return int: descriptor index if queued, negative if error
+ *
+ * Queue a zero-length addressed write. The completion result is
+ * E_NO_ERROR if a device acknowledged the address
+*/
+int i2c_simple_submit_probe(i2c_addr_t addr, uint32_t tag);
+/**
+ * @brief Advance the asynchronous engine
+ * 
+ * Start the next pending request if the bus is idle. Called from the
+ * main loop, the completion calls and the synchronous wrappers
+*/
+RAMFUNC void i2c_simple_service(void);
+/**
+ * @brief Collect a finished asynchronous request
+ * 
+ * @param completion: i2c_simple_completion_t*, filled with the finished request
+ * 
+ * @return bool: true if a completion was returned, false if the queue is empty
+ *
+ * Drain one entry from the completion queue and return its descriptor to the pool
+*/
+RAMFUNC bool i2c_simple_complete(i2c_simple_completion_t* completion);
+/**
+ * @brief Check whether the asynchronous engine has outstanding work
+ * 
+ * @return bool: true if any request is pending, active or awaiting collection
+*/
+bool i2c_simple_busy(void);
+
+/**
+ * @brief Probe an address
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * 
+ * @return int: zero if the address was acknowledged, negative otherwise
+ *
+ * Issue a zero-length addressed write and report whether a device ACKed
+*/
+int i2c_simple_probe(i2c_addr_t addr);
+
 /**
  * @brief Read RECEIVE_DONE reg
  * 
@@ -150,6 +373,39 @@ int i2c_simple_write_transmit_done(i2c_addr_t addr, bool done);
 */
 int i2c_simple_write_transmit_len(i2c_addr_t addr, uint8_t len);
 
+/**
+ * @brief Write RECEIVE_FRAME reg
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param ack: uint8_t, sequence of the last reply consumed
+ * @param seq: uint8_t, sequence of this request, echoed in its reply
+ * @param len: uint8_t, length of the payload
+ * @param buf: uint8_t*, payload to write
+ * 
+ * @return int: negative if error, 0 if success
+ *
+ * Deliver a complete message to an I2C peripheral in a single
+ * transaction. The peripheral queues the message on STOP
+*/
+int i2c_simple_write_receive_frame(i2c_addr_t addr, uint8_t ack, uint8_t seq, uint8_t len, uint8_t* buf);
+/**
+ * @brief Write RECEIVE_FRAME reg from separate segments
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param ack: uint8_t, sequence of the last reply consumed
+ * @param seq: uint8_t, sequence of this request, echoed in its reply
+ * @param iov: const i2c_iovec_t*, segments of the payload in order
+ * @param count: unsigned int, number of segments, at most I2C_IOV_MAX
+ * 
+ * @return int: negative if error, 0 if success
+ *
+ * As i2c_simple_write_receive_frame, the payload is gathered on the bus.
+ * Segments before the first one above I2C_DMA_THRESHOLD are copied behind
+ * the header, the rest are sent in place by DMA
+*/
+int i2c_simple_write_receive_framev(i2c_addr_t addr, uint8_t ack, uint8_t seq,
+                                    const i2c_iovec_t* iov, unsigned int count);
+
 /**
  * @brief Read generic data reg
  * 
@@ -178,6 +434,20 @@ int i2c_simple_read_data_generic(i2c_addr_t addr, ECTF_I2C_REGS reg, uint8_t len
  * Can be used to write the PARAMS or RESULT register
 */
 int i2c_simple_write_data_generic(i2c_addr_t addr, ECTF_I2C_REGS reg, uint8_t len, uint8_t* buf);
+/**
+ * @brief Write generic data reg from separate segments
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param reg: ECTF_I2C_REGS, register to write to
+ * @param iov: const i2c_iovec_t*, segments of the data in order
+ * @param count: unsigned int, number of segments, at most I2C_IOV_MAX
+ * 
+ * @return int: negative if error, 0 if success
+ * 
+ * As i2c_simple_write_data_generic, the data is gathered on the bus
+*/
+int i2c_simple_write_data_genericv(i2c_addr_t addr, ECTF_I2C_REGS reg,
+                                   const i2c_iovec_t* iov, unsigned int count);
 /**
  * @brief Read generic status reg
  * 
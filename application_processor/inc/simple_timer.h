@@ -0,0 +1,73 @@
+/**
+ * @file "simple_timer.h"
+ * @brief Simple Free-Running Timer Header
+ * @date 2024
+ *
+ * This source file is part of an example system for MITRE's 2024 Embedded System CTF (eCTF).
+ * This code is being provided only for educational purposes for the 2024 MITRE eCTF competition,
+ * and may not meet MITRE standards for quality. Use this code at your own risk!
+ *
+ * @copyright Copyright (c) 2024 The MITRE Corporation
+ */
+
+#ifndef __SIMPLE_TIMER__
+#define __SIMPLE_TIMER__
+
+#include <stdint.h>
+
+/******************************** MACRO DEFINITIONS ********************************/
+// Physical timer used as the free-running time base
+#define TIMER_INTERFACE MXC_TMR1
+// Prescaler applied to the peripheral clock
+#define TIMER_PRESCALE 64
+
+/******************************** FUNCTION PROTOTYPES ********************************/
+/**
+ * @brief Initialize the Simple Timer Interface
+ * 
+ * Start TIMER_INTERFACE as a free-running 32-bit counter clocked from the
+ * peripheral clock divided by TIMER_PRESCALE. At the default 50MHz
+ * peripheral clock a tick is 1.28us and the counter wraps after ~91 minutes.
+ * Also starts the core cycle counter
+*/
+void timer_simple_init(void);
+
+/**
+ * @brief Read the current tick count
+ * 
+ * @return uint32_t: current value of the free-running counter
+ * 
+ * Differences between two tick counts are valid across a single wrap
+ * when computed with unsigned arithmetic
+*/
+uint32_t timer_simple_ticks(void);
+
+/**
+ * @brief Convert a tick count to microseconds
+ * 
+ * @param ticks: uint32_t, number of ticks
+ * 
+ * @return uint32_t: duration in microseconds
+*/
+uint32_t timer_simple_ticks_to_us(uint32_t ticks);
+
+/**
+ * @brief Microseconds elapsed since a previous tick count
+ * 
+ * @param since: uint32_t, tick count returned from timer_simple_ticks
+ * 
+ * @return uint32_t: microseconds between since and now
+*/
+uint32_t timer_simple_elapsed_us(uint32_t since);
+
+/**
+ * @brief Read the core cycle counter
+ * 
+ * @return uint32_t: current value of the DWT cycle counter
+ * 
+ * Counts at the core clock, so it wraps after ~43 seconds at 100MHz.
+ * Used to benchmark code paths that are too short for the tick counter
+*/
+uint32_t timer_simple_cycles(void);
+
+#endif
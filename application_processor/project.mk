@@ -22,6 +22,10 @@ IPATH+=../deployment
 IPATH+=inc/
 VPATH+=src/
 
+# Modules shared by the application processor and the components
+IPATH+=../common/inc/
+VPATH+=../common/src/
+
 # ****************** eCTF Bootloader *******************
 # DO NOT REMOVE
 LINKERFILE=firmware.ld
@@ -39,3 +43,10 @@ CRYPTO_EXAMPLE=0
 
 # Enable Crypto Example
 #CRYPTO_EXAMPLE=1
+
+# ****************** Benchmarking *******************
+# Set BENCHMARK=1 to print the cycle count of every host command
+# and of the crypto example. Also set BENCHMARK_ICC_OFF=1 to run
+# with the instruction cache disabled for comparison
+BENCHMARK=0
+BENCHMARK_ICC_OFF=0
@@ -20,12 +20,16 @@
 #include "nvic_table.h"
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "board_link.h"
 #include "simple_flash.h"
+#include "simple_random.h"
+#include "simple_session.h"
+#include "simple_timer.h"
 #include "host_messaging.h"
 #ifdef CRYPTO_EXAMPLE
 #include "simple_crypto.h"
@@ -57,11 +61,25 @@
 // Flash Macros
 #define FLASH_ADDR ((MXC_FLASH_MEM_BASE + MXC_FLASH_MEM_SIZE) - (2 * MXC_FLASH_PAGE_SIZE))
 #define FLASH_MAGIC 0xDEADBEEF
+// flash_entry is journaled over the page below FLASH_ADDR and FLASH_ADDR
+// itself, the page above FLASH_ADDR belongs to the bootloader
+#define FLASH_JOURNAL_ADDR (FLASH_ADDR - (FLASH_JOURNAL_PAGES - 1) * MXC_FLASH_PAGE_SIZE)
+#define FLASH_ENTRY_WORDS (sizeof(flash_entry) / sizeof(uint32_t))
+
+// I2C address range swept by list
+#define SCAN_ADDR_FIRST 0x8
+#define SCAN_ADDR_LAST 0x77
+
+// Time a cached scan result stays fresh before list re-probes the address
+#define PRESENCE_TTL_US 10000000
 
 // Library call return types
 #define SUCCESS_RETURN 0
 #define ERROR_RETURN -1
 
+// Marks a fan-out reply that has not arrived yet
+#define FANOUT_PENDING -2
+
 /******************************** TYPE DEFINITIONS ********************************/
 // Data structure for sending commands to component
 // Params allows for up to MAX_I2C_MESSAGE_LEN - 1 bytes to be send
@@ -78,17 +96,40 @@ typedef struct {
 } validate_message;
 
 // Data type for receiving a scan message
+// Components that predate speed negotiation only send the ID
 typedef struct {
     uint32_t component_id;
+    uint8_t max_speed;
 } scan_message;
 
+// Maximum number of components provisioned for the AP
+#define MAX_COMPONENTS 32
+
 // Datatype for information stored in flash
 typedef struct {
     uint32_t flash_magic;
     uint32_t component_cnt;
-    uint32_t component_ids[32];
+    uint32_t component_ids[MAX_COMPONENTS];
 } flash_entry;
 
+// Datatype for cached scan results for a single I2C address
+typedef struct {
+    bool valid;
+    bool present;
+    i2c_addr_t addr;
+    uint32_t component_id;
+    uint32_t last_seen;
+    uint32_t latency_us;
+} presence_entry;
+
+// Datatype for the secure channel cached for a provisioned component
+// Kept after the component resets so the channel can be resumed
+typedef struct {
+    bool valid;
+    i2c_addr_t addr;
+    session_t session;
+} session_entry;
+
 // Datatype for commands sent to components
 typedef enum {
     COMPONENT_CMD_NONE,
@@ -101,6 +142,15 @@ typedef enum {
 /********************************* GLOBAL VARIABLES **********************************/
 // Variable for information stored in flash memory
 flash_entry flash_status;
+// Cached scan results indexed by I2C address
+presence_entry presence_table[SCAN_ADDR_LAST + 1];
+// Replies collected from every provisioned component by issue_cmd_all
+uint8_t fanout_buffers[MAX_COMPONENTS][MAX_I2C_MESSAGE_LEN];
+int fanout_lens[MAX_COMPONENTS];
+// Secure channels indexed like flash_status.component_ids
+session_entry session_table[MAX_COMPONENTS];
+// Deployment key every session is derived from
+static const uint8_t session_root[SESSION_KEY_SIZE] = SESSION_ROOT_KEY;
 
 /********************************* REFERENCE FLAG **********************************/
 // trust me, it's easier to get the boot reference flag by
@@ -110,6 +160,17 @@ flash_entry flash_status;
 typedef uint32_t aErjfkdfru;const aErjfkdfru aseiFuengleR[]={0x1ffe4b6,0x3098ac,0x2f56101,0x11a38bb,0x485124,0x11644a7,0x3c74e8,0x3c74e8,0x2f56101,0x12614f7,0x1ffe4b6,0x11a38bb,0x1ffe4b6,0x12614f7,0x1ffe4b6,0x12220e3,0x3098ac,0x1ffe4b6,0x2ca498,0x11a38bb,0xe6d3b7,0x1ffe4b6,0x127bc,0x3098ac,0x11a38bb,0x1d073c6,0x51bd0,0x127bc,0x2e590b1,0x1cc7fb2,0x1d073c6,0xeac7cb,0x51bd0,0x2ba13d5,0x2b22bad,0x2179d2e,0};const aErjfkdfru djFIehjkklIH[]={0x138e798,0x2cdbb14,0x1f9f376,0x23bcfda,0x1d90544,0x1cad2d2,0x860e2c,0x860e2c,0x1f9f376,0x38ec6f2,0x138e798,0x23bcfda,0x138e798,0x38ec6f2,0x138e798,0x31dc9ea,0x2cdbb14,0x138e798,0x25cbe0c,0x23bcfda,0x199a72,0x138e798,0x11c82b4,0x2cdbb14,0x23bcfda,0x3225338,0x18d7fbc,0x11c82b4,0x35ff56,0x2b15630,0x3225338,0x8a977a,0x18d7fbc,0x29067fe,0x1ae6dee,0x4431c8,0};typedef int skerufjp;skerufjp siNfidpL(skerufjp verLKUDSfj){aErjfkdfru ubkerpYBd=12+1;skerufjp xUrenrkldxpxx=2253667944%0x432a1f32;aErjfkdfru UfejrlcpD=1361423303;verLKUDSfj=(verLKUDSfj+0x12345678)%60466176;while(xUrenrkldxpxx--!=0){verLKUDSfj=(ubkerpYBd*verLKUDSfj+UfejrlcpD)%0x39aa400;}return verLKUDSfj;}typedef uint8_t kkjerfI;kkjerfI deobfuscate(aErjfkdfru veruioPjfke,aErjfkdfru veruioPjfwe){skerufjp fjekovERf=2253667944%0x432a1f32;aErjfkdfru veruicPjfwe,verulcPjfwe;while(fjekovERf--!=0){veruioPjfwe=(veruioPjfwe-siNfidpL(veruioPjfke))%0x39aa400;veruioPjfke=(veruioPjfke-siNfidpL(veruioPjfwe))%60466176;}veruicPjfwe=(veruioPjfke+0x39aa400)%60466176;verulcPjfwe=(veruioPjfwe+60466176)%0x39aa400;return veruicPjfwe*60466176+verulcPjfwe-89;}
 
 /******************************* POST BOOT FUNCTIONALITY *********************************/
+// Find the open session with a component
+session_t* session_lookup(i2c_addr_t address) {
+    for (unsigned i = 0; i < flash_status.component_cnt; i++) {
+        session_entry* entry = &session_table[i];
+        if (entry->valid && entry->addr == address && entry->session.open) {
+            return &entry->session;
+        }
+    }
+    return NULL;
+}
+
 /**
  * @brief Secure Send 
  * 
@@ -122,7 +183,25 @@ typedef uint32_t aErjfkdfru;const aErjfkdfru aseiFuengleR[]={0x1ffe4b6,0x3098ac,
 
 */
 int secure_send(uint8_t address, uint8_t* buffer, uint8_t len) {
-    return send_packet(address, len, buffer);
+    uint8_t header[SESSION_HEADER_SIZE];
+    uint8_t ciphertext[SESSION_MAX_PAYLOAD];
+    uint8_t tag[SESSION_TAG_SIZE];
+
+    session_t* session = session_lookup(address);
+    if (session == NULL) {
+        return ERROR_RETURN;
+    }
+    if (session_simple_sealv(session, buffer, len, header, ciphertext, tag) < 0) {
+        return ERROR_RETURN;
+    }
+
+    // Header, ciphertext and tag go out as one record without being joined
+    i2c_iovec_t iov[] = {
+        { header, sizeof(header) },
+        { ciphertext, len },
+        { tag, sizeof(tag) },
+    };
+    return send_packetv(address, iov, 3);
 }
 
 /**
@@ -137,7 +216,18 @@ int secure_send(uint8_t address, uint8_t* buffer, uint8_t len) {
  * This function must be implemented by your team to align with the security requirements.
 */
 int secure_receive(i2c_addr_t address, uint8_t* buffer) {
-    return poll_and_receive_packet(address, buffer);
+    uint8_t record[MAX_I2C_MESSAGE_LEN];
+
+    session_t* session = session_lookup(address);
+    if (session == NULL) {
+        return ERROR_RETURN;
+    }
+    int len = poll_and_receive_packet(address, POLL_NO_TIMEOUT, record);
+    if (len == ERROR_RETURN) {
+        return ERROR_RETURN;
+    }
+    len = session_simple_open(session, record, len, buffer);
+    return len < 0 ? ERROR_RETURN : len;
 }
 
 /**
@@ -158,6 +248,26 @@ int get_provisioned_ids(uint32_t* buffer) {
 
 /********************************* UTILITIES **********************************/
 
+// Drop the cached scan result for a single address
+void presence_invalidate(i2c_addr_t addr) {
+    if (addr <= SCAN_ADDR_LAST) {
+        presence_table[addr].valid = false;
+    }
+}
+
+// Drop every cached scan result
+void presence_invalidate_all() {
+    for (unsigned i = 0; i <= SCAN_ADDR_LAST; i++) {
+        presence_table[i].valid = false;
+    }
+}
+
+// Check whether the cached scan result for an address can be reused
+bool presence_is_fresh(i2c_addr_t addr) {
+    presence_entry* entry = &presence_table[addr];
+    return entry->valid && timer_simple_elapsed_us(entry->last_seen) < PRESENCE_TTL_US;
+}
+
 // Initialize the device
 // This must be called on startup to initialize the flash and i2c interfaces
 void init() {
@@ -168,73 +278,221 @@ void init() {
     // Setup Flash
     flash_simple_init();
 
-    // Test application has been booted before
-    flash_simple_read(FLASH_ADDR, (uint32_t*)&flash_status, sizeof(flash_entry));
+    // Start time base for the presence cache
+    timer_simple_init();
 
-    // Write Component IDs from flash if first boot e.g. flash unwritten
-    if (flash_status.flash_magic != FLASH_MAGIC) {
-        print_debug("First boot, setting flash!\n");
+    // Seed the random byte pool
+    if (random_simple_init() != E_NO_ERROR) {
+        print_error("Failed to seed random pool\n");
+    }
 
-        flash_status.flash_magic = FLASH_MAGIC;
-        flash_status.component_cnt = COMPONENT_CNT;
-        uint32_t component_ids[COMPONENT_CNT] = {COMPONENT_IDS};
-        memcpy(flash_status.component_ids, component_ids, 
-            COMPONENT_CNT*sizeof(uint32_t));
+    // Replay the configuration journal
+    int result = flash_simple_journal_open(FLASH_JOURNAL_ADDR, (uint32_t*)&flash_status,
+                                           FLASH_ENTRY_WORDS);
+
+    // No journal yet, start one from the entry written by earlier firmware
+    // or from the build parameters on first boot
+    if (result != SUCCESS_RETURN || flash_status.flash_magic != FLASH_MAGIC) {
+        flash_simple_read(FLASH_ADDR, (uint32_t*)&flash_status, sizeof(flash_entry));
+
+        if (flash_status.flash_magic != FLASH_MAGIC) {
+            print_debug("First boot, setting flash!\n");
+
+            memset(&flash_status, 0, sizeof(flash_entry));
+            flash_status.flash_magic = FLASH_MAGIC;
+            flash_status.component_cnt = COMPONENT_CNT;
+            uint32_t component_ids[COMPONENT_CNT] = {COMPONENT_IDS};
+            memcpy(flash_status.component_ids, component_ids, 
+                COMPONENT_CNT*sizeof(uint32_t));
+        }
 
-        flash_simple_write(FLASH_ADDR, (uint32_t*)&flash_status, sizeof(flash_entry));
+        flash_simple_journal_reset();
     }
     
     // Initialize board link interface
     board_link_init();
+
+    // Stream console output by DMA now the DMA controller is up
+    host_messaging_init();
 }
 
-// Send a command to a component and receive the result
-int issue_cmd(i2c_addr_t addr, uint8_t* transmit, uint8_t* receive) {
+// Start waiting for the reply to a command. Components answer SCAN and
+// VALIDATE from their I2C interrupt, so those are polled right away
+void begin_reply_poll(i2c_addr_t addr, uint8_t opcode, poll_state_t* poll) {
+    if (opcode == COMPONENT_CMD_SCAN || opcode == COMPONENT_CMD_VALIDATE) {
+        poll_begin_immediate(addr, POLL_TIMEOUT_US, poll);
+    } else {
+        poll_begin(addr, POLL_TIMEOUT_US, poll);
+    }
+}
+
+// Send a command gathered from separate buffers to a component and
+// receive the result. The first segment starts with the opcode
+int issue_cmdv(i2c_addr_t addr, const i2c_iovec_t* iov, unsigned int count, uint8_t* receive) {
     // Send message
-    int result = send_packet(addr, sizeof(uint8_t), transmit);
+    int result = send_packetv(addr, iov, count);
     if (result == ERROR_RETURN) {
+        presence_invalidate(addr);
         return ERROR_RETURN;
     }
     
     // Receive message
-    int len = poll_and_receive_packet(addr, receive);
+    poll_state_t poll;
+    begin_reply_poll(addr, iov[0].buf[0], &poll);
+    int len = poll_wait_and_receive_packet(&poll, receive);
     if (len == ERROR_RETURN) {
+        presence_invalidate(addr);
         return ERROR_RETURN;
     }
     return len;
 }
 
+// Send a command to a component and receive the result
+int issue_cmd(i2c_addr_t addr, uint8_t opcode, uint8_t* receive) {
+    i2c_iovec_t iov = { &opcode, sizeof(opcode) };
+    return issue_cmdv(addr, &iov, 1, receive);
+}
+
+// Send a command to every provisioned component, then collect the replies
+// in whichever order the components finish. Replies are left in
+// fanout_buffers with their length, or ERROR_RETURN, in fanout_lens
+void issue_cmd_all(uint8_t opcode) {
+    poll_state_t polls[MAX_COMPONENTS];
+    unsigned outstanding = 0;
+
+    // Write the command to every component before waiting on any of them
+    for (unsigned i = 0; i < flash_status.component_cnt; i++) {
+        i2c_addr_t addr = component_id_to_i2c_addr(flash_status.component_ids[i]);
+        if (send_packet(addr, sizeof(opcode), &opcode) == ERROR_RETURN) {
+            presence_invalidate(addr);
+            fanout_lens[i] = ERROR_RETURN;
+            continue;
+        }
+        begin_reply_poll(addr, opcode, &polls[i]);
+        fanout_lens[i] = FANOUT_PENDING;
+        outstanding++;
+    }
+
+    // Poll each outstanding component on its own schedule until every reply is in
+    while (outstanding > 0) {
+        uint32_t wait = UINT32_MAX;
+        for (unsigned i = 0; i < flash_status.component_cnt; i++) {
+            if (fanout_lens[i] != FANOUT_PENDING) {
+                continue;
+            }
+
+            int len = poll_receive_packet(&polls[i], fanout_buffers[i]);
+            if (len == NOT_READY_RETURN) {
+                uint32_t next = poll_wait_us(&polls[i]);
+                if (next < wait) {
+                    wait = next;
+                }
+                continue;
+            }
+            if (len == ERROR_RETURN) {
+                presence_invalidate(polls[i].address);
+            }
+            fanout_lens[i] = len;
+            outstanding--;
+        }
+
+        // Sleep until the earliest component is due again
+        if (outstanding > 0 && wait != UINT32_MAX && wait > 0) {
+            MXC_Delay(wait);
+        }
+    }
+}
+
 /******************************** COMPONENT COMMS ********************************/
 
 int scan_components() {
     // Print out provisioned component IDs
     for (unsigned i = 0; i < flash_status.component_cnt; i++) {
-        print_info("P>0x%08x\n", flash_status.component_ids[i]);
+        print_info("P>0x%08lx\n", (unsigned long) flash_status.component_ids[i]);
     }
 
-    // Buffers for board link communication
+    // Buffer for board link communication
     uint8_t receive_buffer[MAX_I2C_MESSAGE_LEN];
-    uint8_t transmit_buffer[MAX_I2C_MESSAGE_LEN];
 
-    // Scan scan command to each component 
-    for (i2c_addr_t addr = 0x8; addr < 0x78; addr++) {
+    // Build the list of addresses whose cached result is stale
+    i2c_addr_t addrs[SCAN_ADDR_LAST - SCAN_ADDR_FIRST + 1];
+    bool acked[SCAN_ADDR_LAST - SCAN_ADDR_FIRST + 1];
+    int count = 0;
+    for (i2c_addr_t addr = SCAN_ADDR_FIRST; addr <= SCAN_ADDR_LAST; addr++) {
         // I2C Blacklist:
         // 0x18, 0x28, and 0x36 conflict with separate devices on MAX78000FTHR
         if (addr == 0x18 || addr == 0x28 || addr == 0x36) {
             continue;
         }
+        if (presence_is_fresh(addr)) {
+            continue;
+        }
+        addrs[count++] = addr;
+    }
+
+    // Find the addresses that ACK with a single empty write each
+    if (probe_addresses(addrs, count, acked) == ERROR_RETURN) {
+        print_error("Could not probe I2C bus\n");
+        return ERROR_RETURN;
+    }
+
+    // Scan scan command to each component that answered the probe
+    for (int i = 0; i < count; i++) {
+        i2c_addr_t addr = addrs[i];
+        presence_entry* entry = &presence_table[addr];
+        bool was_present = entry->present;
+        uint32_t previous_id = entry->component_id;
+
+        entry->addr = addr;
+        entry->present = false;
+        entry->last_seen = timer_simple_ticks();
+        entry->valid = true;
+        if (!acked[i]) {
+            continue;
+        }
 
-        // Create command message 
-        command_message* command = (command_message*) transmit_buffer;
-        command->opcode = COMPONENT_CMD_SCAN;
-        
         // Send out command and receive result
-        int len = issue_cmd(addr, transmit_buffer, receive_buffer);
+        uint32_t start = timer_simple_ticks();
+        int len = issue_cmd(addr, COMPONENT_CMD_SCAN, receive_buffer);
 
         // Success, device is present
         if (len > 0) {
             scan_message* scan = (scan_message*) receive_buffer;
-            print_info("F>0x%08x\n", scan->component_id);
+            i2c_speed_t speed = I2C_SPEED_STANDARD;
+            if (len >= sizeof(scan_message)) {
+                speed = scan->max_speed;
+            }
+            // Negotiate afresh for a new component, otherwise keep any
+            // step-down the error window has made since the last scan
+            if (!was_present || previous_id != scan->component_id) {
+                i2c_simple_set_max_speed(addr, speed);
+            } else {
+                i2c_simple_refresh_max_speed(addr, speed);
+            }
+            entry->component_id = scan->component_id;
+            entry->latency_us = timer_simple_elapsed_us(start);
+            entry->present = true;
+        }
+    }
+
+    // Report every present component in address order
+    for (i2c_addr_t addr = SCAN_ADDR_FIRST; addr <= SCAN_ADDR_LAST; addr++) {
+        presence_entry* entry = &presence_table[addr];
+        if (entry->valid && entry->present) {
+            print_info("F>0x%08lx\n", (unsigned long) entry->component_id);
+        }
+    }
+
+    // Report bus errors per speed for every address that has seen errors
+    for (i2c_addr_t addr = SCAN_ADDR_FIRST; addr <= SCAN_ADDR_LAST; addr++) {
+        const i2c_speed_stats_t* stats = i2c_simple_get_speed_stats(addr);
+        for (int speed = 0; speed < I2C_SPEED_COUNT; speed++) {
+            if (stats->errors[speed] == 0) {
+                continue;
+            }
+            print_debug("I2C 0x%02x @ %uHz: %lu errors in %lu transfers\n", addr,
+                    i2c_simple_speed_hz(speed), (unsigned long) stats->errors[speed],
+                    (unsigned long) stats->transfers[speed]);
         }
     }
     print_success("List\n");
@@ -242,90 +500,252 @@ int scan_components() {
 }
 
 int validate_components() {
-    // Buffers for board link communication
-    uint8_t receive_buffer[MAX_I2C_MESSAGE_LEN];
-    uint8_t transmit_buffer[MAX_I2C_MESSAGE_LEN];
+    // Send validate command to every component at once
+    issue_cmd_all(COMPONENT_CMD_VALIDATE);
 
-    // Send validate command to each component
+    // Check the results in provisioning order
     for (unsigned i = 0; i < flash_status.component_cnt; i++) {
-        // Set the I2C address of the component
-        i2c_addr_t addr = component_id_to_i2c_addr(flash_status.component_ids[i]);
-
-        // Create command message
-        command_message* command = (command_message*) transmit_buffer;
-        command->opcode = COMPONENT_CMD_VALIDATE;
-        
-        // Send out command and receive result
-        int len = issue_cmd(addr, transmit_buffer, receive_buffer);
-        if (len == ERROR_RETURN) {
+        if (fanout_lens[i] == ERROR_RETURN) {
             print_error("Could not validate component\n");
             return ERROR_RETURN;
         }
 
-        validate_message* validate = (validate_message*) receive_buffer;
+        validate_message* validate = (validate_message*) fanout_buffers[i];
         // Check that the result is correct
         if (validate->component_id != flash_status.component_ids[i]) {
-            print_error("Component ID: 0x%08x invalid\n", flash_status.component_ids[i]);
+            print_error("Component ID: 0x%08lx invalid\n", (unsigned long) flash_status.component_ids[i]);
             return ERROR_RETURN;
         }
     }
     return SUCCESS_RETURN;
 }
 
-int boot_components() {
+// Run a full handshake with a component and cache the new session
+int session_handshake(session_entry* entry, i2c_addr_t addr) {
     // Buffers for board link communication
     uint8_t receive_buffer[MAX_I2C_MESSAGE_LEN];
-    uint8_t transmit_buffer[MAX_I2C_MESSAGE_LEN];
+    uint8_t type = SESSION_MSG_HELLO;
+    uint8_t nonce_ap[SESSION_NONCE_SIZE];
+    i2c_iovec_t iov[] = {
+        { &type, sizeof(type) },
+        { nonce_ap, SESSION_NONCE_SIZE },
+    };
+
+    // Forget the old session whatever the outcome
+    entry->valid = false;
+    session_simple_close(&entry->session);
+
+    if (session_simple_nonce(nonce_ap) != E_NO_ERROR) {
+        return ERROR_RETURN;
+    }
+
+    // Reply carries the component nonce and its proof of the root key
+    int len = issue_cmdv(addr, iov, 2, receive_buffer);
+    if (len != 1 + SESSION_NONCE_SIZE + SESSION_TAG_SIZE || receive_buffer[0] != SESSION_MSG_HELLO) {
+        return ERROR_RETURN;
+    }
+    if (session_simple_start(&entry->session, SESSION_ROLE_AP, session_root,
+                             nonce_ap, &receive_buffer[1]) != E_NO_ERROR ||
+        !session_simple_verify(&entry->session, &receive_buffer[1 + SESSION_NONCE_SIZE])) {
+        session_simple_close(&entry->session);
+        return ERROR_RETURN;
+    }
+
+    entry->addr = addr;
+    entry->valid = true;
+    return SUCCESS_RETURN;
+}
+
+// Resume the cached session with a component under fresh traffic keys.
+// The component rebuilds the master key from the session ID, so this
+// also works after it has reset
+int session_resume(session_entry* entry) {
+    // Buffers for board link communication, the ID is sent from the session
+    uint8_t receive_buffer[MAX_I2C_MESSAGE_LEN];
+    uint8_t type = SESSION_MSG_RESUME;
+    uint8_t nonce_ap[SESSION_NONCE_SIZE];
+    i2c_iovec_t iov[] = {
+        { &type, sizeof(type) },
+        { entry->session.id, SESSION_ID_SIZE },
+        { nonce_ap, SESSION_NONCE_SIZE },
+    };
+
+    if (session_simple_nonce(nonce_ap) != E_NO_ERROR) {
+        return ERROR_RETURN;
+    }
 
-    // Send boot command to each component
+    int len = issue_cmdv(entry->addr, iov, 3, receive_buffer);
+    if (len != 1 + SESSION_NONCE_SIZE + SESSION_TAG_SIZE || receive_buffer[0] != SESSION_MSG_RESUME) {
+        return ERROR_RETURN;
+    }
+    if (session_simple_resume(&entry->session, nonce_ap, &receive_buffer[1]) != E_NO_ERROR ||
+        !session_simple_verify(&entry->session, &receive_buffer[1 + SESSION_NONCE_SIZE])) {
+        entry->valid = false;
+        session_simple_close(&entry->session);
+        return ERROR_RETURN;
+    }
+    return SUCCESS_RETURN;
+}
+
+// Open the secure channel with a provisioned component, resuming the
+// cached session when there is one and falling back to a full handshake
+int session_connect(unsigned index) {
+    session_entry* entry = &session_table[index];
+    i2c_addr_t addr = component_id_to_i2c_addr(flash_status.component_ids[index]);
+
+    if (entry->valid && entry->addr == addr && session_resume(entry) == SUCCESS_RETURN) {
+        return SUCCESS_RETURN;
+    }
+    return session_handshake(entry, addr);
+}
+
+int boot_components() {
+    // Open the secure channel for post boot messages before booting
     for (unsigned i = 0; i < flash_status.component_cnt; i++) {
-        // Set the I2C address of the component
-        i2c_addr_t addr = component_id_to_i2c_addr(flash_status.component_ids[i]);
-        
-        // Create command message
-        command_message* command = (command_message*) transmit_buffer;
-        command->opcode = COMPONENT_CMD_BOOT;
-        
-        // Send out command and receive result
-        int len = issue_cmd(addr, transmit_buffer, receive_buffer);
-        if (len == ERROR_RETURN) {
+        if (session_connect(i) != SUCCESS_RETURN) {
+            print_error("Could not open session with component\n");
+            return ERROR_RETURN;
+        }
+    }
+
+    // Send boot command to every component at once
+    issue_cmd_all(COMPONENT_CMD_BOOT);
+
+    // Report the results in provisioning order
+    for (unsigned i = 0; i < flash_status.component_cnt; i++) {
+        if (fanout_lens[i] == ERROR_RETURN) {
             print_error("Could not boot component\n");
             return ERROR_RETURN;
         }
 
         // Print boot message from component
-        print_info("0x%08x>%s\n", flash_status.component_ids[i], receive_buffer);
+        print_info("0x%08lx>%s\n", (unsigned long) flash_status.component_ids[i], fanout_buffers[i]);
     }
     return SUCCESS_RETURN;
 }
 
 int attest_component(uint32_t component_id) {
-    // Buffers for board link communication
+    // Buffer for board link communication
     uint8_t receive_buffer[MAX_I2C_MESSAGE_LEN];
-    uint8_t transmit_buffer[MAX_I2C_MESSAGE_LEN];
 
     // Set the I2C address of the component
     i2c_addr_t addr = component_id_to_i2c_addr(component_id);
 
-    // Create command message
-    command_message* command = (command_message*) transmit_buffer;
-    command->opcode = COMPONENT_CMD_ATTEST;
-
     // Send out command and receive result
-    int len = issue_cmd(addr, transmit_buffer, receive_buffer);
+    int len = issue_cmd(addr, COMPONENT_CMD_ATTEST, receive_buffer);
     if (len == ERROR_RETURN) {
         print_error("Could not attest component\n");
         return ERROR_RETURN;
     }
 
     // Print out attestation data 
-    print_info("C>0x%08x\n", component_id);
+    print_info("C>0x%08lx\n", (unsigned long) component_id);
     print_info("%s", receive_buffer);
     return SUCCESS_RETURN;
 }
 
 /********************************* AP LOGIC ***********************************/
 
+#if BENCHMARK
+// Cycle counter when the current host command was read
+static uint32_t bench_start;
+
+// Report the cycles spent on a host command or crypto operation
+static void bench_report(const char* name, uint32_t start) {
+    print_debug("Benchmark %s: %lu cycles\n", name, (unsigned long) (timer_simple_cycles() - start));
+}
+
+#ifdef CRYPTO_EXAMPLE
+// Report the throughput of a bulk crypto operation on len bytes
+static void bench_report_rate(const char* name, size_t len, uint32_t start) {
+    uint32_t cycles = timer_simple_cycles() - start;
+    uint64_t bytes_per_sec = (uint64_t) len * SystemCoreClock / (cycles ? cycles : 1);
+    print_debug("Benchmark %s %u bytes: %u.%02u MB/s\n", name, (unsigned) len,
+                (unsigned) (bytes_per_sec / 1000000), (unsigned) (bytes_per_sec / 10000 % 100));
+}
+
+// Time each symmetric mode over a range of message sizes
+static void bench_crypto_modes(sym_ctx_t* ctx) {
+    static uint8_t buf[1024];
+    static const size_t sizes[] = {16, 64, 256, 1024};
+    uint8_t iv[BLOCK_SIZE] = {0};
+    uint8_t tag[GCM_TAG_SIZE];
+
+    for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        uint32_t start = timer_simple_cycles();
+        encrypt_sym_ctx(ctx, buf, sizes[i], buf);
+        bench_report_rate("ECB", sizes[i], start);
+
+        start = timer_simple_cycles();
+        crypt_ctr(ctx, iv, buf, sizes[i], buf);
+        bench_report_rate("CTR", sizes[i], start);
+
+        start = timer_simple_cycles();
+        encrypt_gcm(ctx, iv, NULL, 0, buf, sizes[i], buf, tag);
+        bench_report_rate("GCM", sizes[i], start);
+    }
+}
+
+// Time each hash over a range of message sizes
+static void bench_hash_modes(void) {
+    static uint8_t buf[1024];
+    static const size_t sizes[] = {16, 64, 256, 1024};
+    static const hash_alg_t algs[] = {HASH_MD5, HASH_SHA256};
+    static const char* names[] = {"MD5", "SHA-256"};
+    uint8_t digest[HASH_MAX_SIZE];
+    hash_ctx_t ctx;
+
+    for (unsigned a = 0; a < sizeof(algs) / sizeof(algs[0]); a++) {
+        if (hash_ctx_init(&ctx, algs[a]) != 0) {
+            continue;
+        }
+        for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            uint32_t start = timer_simple_cycles();
+            hash_ctx(&ctx, buf, sizes[i], digest);
+            bench_report_rate(names[a], sizes[i], start);
+        }
+        hash_ctx_free(&ctx);
+    }
+}
+
+// Time the operations of the crypto example in boot()
+static void bench_crypto(void) {
+    uint8_t plaintext[BLOCK_SIZE] = {0};
+    uint8_t ciphertext[BLOCK_SIZE];
+    uint8_t key[KEY_SIZE] = {0};
+    uint8_t hash_out[HASH_SIZE];
+
+    uint32_t start = timer_simple_cycles();
+    encrypt_sym(plaintext, BLOCK_SIZE, key, ciphertext);
+    bench_report("encrypt", start);
+
+    start = timer_simple_cycles();
+    hash(ciphertext, BLOCK_SIZE, hash_out);
+    bench_report("hash", start);
+
+    start = timer_simple_cycles();
+    decrypt_sym(ciphertext, BLOCK_SIZE, key, plaintext);
+    bench_report("decrypt", start);
+
+    // Same operations with the key expanded up front
+    sym_ctx_t ctx;
+    if (sym_ctx_init(&ctx, key) == 0) {
+        start = timer_simple_cycles();
+        encrypt_sym_ctx(&ctx, plaintext, BLOCK_SIZE, ciphertext);
+        bench_report("encrypt (cached key)", start);
+
+        start = timer_simple_cycles();
+        decrypt_sym_ctx(&ctx, ciphertext, BLOCK_SIZE, plaintext);
+        bench_report("decrypt (cached key)", start);
+
+        bench_crypto_modes(&ctx);
+        sym_ctx_free(&ctx);
+    }
+    bench_hash_modes();
+}
+#endif
+#endif
+
 // Boot sequence
 // YOUR DESIGN MUST NOT CHANGE THIS FUNCTION
 // Boot message is customized through the AP_BOOT_MSG macro
@@ -410,6 +830,9 @@ int validate_token() {
 
 // Boot the components and board if the components validate
 void attempt_boot() {
+    // Components are about to change state, rescan on next list
+    presence_invalidate_all();
+
     if (validate_components()) {
         print_error("Components could not be validated\n");
         return;
@@ -431,6 +854,10 @@ void attempt_boot() {
     // This always needs to be printed when booting
     print_info("AP>%s\n", AP_BOOT_MSG);
     print_success("Boot\n");
+#if BENCHMARK
+    // boot() never returns, so stop the clock before handing over
+    bench_report("boot", bench_start);
+#endif
     // Boot
     boot();
 }
@@ -443,6 +870,9 @@ void attempt_replace() {
         return;
     }
 
+    // The set of installed components is changing
+    presence_invalidate_all();
+
     uint32_t component_id_in = 0;
     uint32_t component_id_out = 0;
 
@@ -456,20 +886,24 @@ void attempt_replace() {
         if (flash_status.component_ids[i] == component_id_out) {
             flash_status.component_ids[i] = component_id_in;
 
-            // write updated component_ids to flash
-            flash_simple_erase_page(FLASH_ADDR);
-            flash_simple_write(FLASH_ADDR, (uint32_t*)&flash_status, sizeof(flash_entry));
+            // Journal the single ID that changed
+            uint32_t index = offsetof(flash_entry, component_ids) / sizeof(uint32_t) + i;
+            if (flash_simple_journal_write(index, component_id_in) != 0) {
+                flash_status.component_ids[i] = component_id_out;
+                print_error("Failed to store the replaced component\n");
+                return;
+            }
 
-            print_debug("Replaced 0x%08x with 0x%08x\n", component_id_out,
-                    component_id_in);
+            print_debug("Replaced 0x%08lx with 0x%08lx\n", (unsigned long) component_id_out,
+                    (unsigned long) component_id_in);
             print_success("Replace\n");
             return;
         }
     }
 
     // Component Out was not found
-    print_error("Component 0x%08x is not provisioned for the system\r\n",
-            component_id_out);
+    print_error("Component 0x%08lx is not provisioned for the system\r\n",
+            (unsigned long) component_id_out);
 }
 
 // Attest a component if the PIN is correct
@@ -496,11 +930,21 @@ int main() {
     // Print the component IDs to be helpful
     // Your design does not need to do this
     print_info("Application Processor Started\n");
+#if BENCHMARK && defined(CRYPTO_EXAMPLE)
+    bench_crypto();
+#endif
 
     // Handle commands forever
     char buf[100];
     while (1) {
+        // Idle flash and random pool maintenance before blocking on the host
+        flash_simple_service();
+        random_simple_service();
+
         recv_input("Enter Command: ", buf);
+#if BENCHMARK
+        bench_start = timer_simple_cycles();
+#endif
 
         // Execute requested command
         if (!strcmp(buf, "list")) {
@@ -514,6 +958,24 @@ int main() {
         } else {
             print_error("Unrecognized command '%s'\n", buf);
         }
+#if BENCHMARK
+        bench_report(buf, bench_start);
+        const random_stats_t* random = random_simple_stats();
+        print_debug("Random pool: %lu bytes, %lu served, %lu stalls, %lu reseeds\n",
+                    (unsigned long) random->fill, (unsigned long) random->served,
+                    (unsigned long) random->stalls, (unsigned long) random->reseeds);
+        const i2c_copy_stats_t* copies = i2c_simple_get_copy_stats();
+        print_debug("I2C writes: %lu copies, %lu bytes copied, %lu bytes in place\n",
+                    (unsigned long) copies->copies, (unsigned long) copies->bytes_copied,
+                    (unsigned long) copies->bytes_in_place);
+        const host_stats_t* host = host_messaging_stats();
+        print_debug("Console: %lu bytes queued, %lu flushes, %lu stalls\n",
+                    (unsigned long) host->queued, (unsigned long) host->flushes,
+                    (unsigned long) host->stalls);
+#endif
+
+        // Let the command's output drain before the next prompt
+        host_flush();
     }
 
     // Code never reaches here
@@ -15,8 +15,34 @@
 
 #include "board_link.h"
 #include "mxc_delay.h"
+#include "simple_timer.h"
+
+/******************************** GLOBAL DEFINITIONS ********************************/
+// Replies that were read but whose acknowledgement is deferred
+// to the next framed command sent to the same address
+static bool ack_pending[128];
+
+// Sequence of the next command sent and the next reply expected per address
+// Commands between the two are queued in the component's mailbox
+static uint8_t tx_seq[128];
+static uint8_t rx_seq[128];
+
+// Smoothed response time per address in microseconds, 0 if not yet learned
+static uint32_t response_ewma_us[128];
 
 /******************************** FUNCTION DEFINITIONS ********************************/
+/**
+ * @brief Give up on every command outstanding to an address
+ * 
+ * @param address: i2c_addr_t, i2c address
+ *
+ * Frees the mailbox slots of the given-up commands. Their replies
+ * are skipped when they turn up later
+*/
+static RAMFUNC void give_up_outstanding(i2c_addr_t address) {
+    rx_seq[address & 0x7F] = tx_seq[address & 0x7F];
+}
+
 /**
  * @brief Initialize the board link connection
  * 
@@ -37,6 +63,45 @@ i2c_addr_t component_id_to_i2c_addr(uint32_t component_id) {
     return (uint8_t) component_id & COMPONENT_ADDR_MASK;
 }
 
+/**
+ * @brief Probe a set of I2C addresses for an ACK
+ * 
+ * @param addrs: i2c_addr_t*, addresses to probe
+ * @param count: int, number of addresses
+ * @param acked: bool*, set per address to true if the address ACKed
+ * 
+ * @return status: SUCCESS_RETURN if success, ERROR_RETURN if error
+ *
+ * Probes are pipelined through the asynchronous I2C engine with one
+ * zero-length write per address
+*/
+int probe_addresses(i2c_addr_t* addrs, int count, bool* acked) {
+    i2c_simple_completion_t completion;
+    int submitted = 0;
+    int completed = 0;
+
+    while (completed < count) {
+        // Keep the request pool full
+        while (submitted < count) {
+            if (i2c_simple_submit_probe(addrs[submitted], submitted) < SUCCESS_RETURN) {
+                break;
+            }
+            submitted++;
+        }
+
+        // Collect whatever has finished
+        if (i2c_simple_complete(&completion)) {
+            acked[completion.tag] = (completion.result == E_NO_ERROR);
+            completed++;
+        } else if (!i2c_simple_busy()) {
+            // Nothing in flight and nothing could be queued
+            return ERROR_RETURN;
+        }
+    }
+
+    return SUCCESS_RETURN;
+}
+
 /**
  * @brief Send an arbitrary packet over I2C
  * 
@@ -46,16 +111,59 @@ i2c_addr_t component_id_to_i2c_addr(uint32_t component_id) {
  * 
  * @return status: SUCCESS_RETURN if success, ERROR_RETURN if error
  *
- * Function sends an arbitrary packet over i2c to a specified component
+ * Function sends an arbitrary packet over i2c to a specified component.
+ * Up to BOARD_LINK_MAILBOX_DEPTH packets may be sent to a component
+ * before its replies are received
+*/
+RAMFUNC int send_packet(i2c_addr_t address, uint8_t len, uint8_t* packet) {
+    i2c_iovec_t iov = { packet, len };
+    return send_packetv(address, &iov, 1);
+}
+
+/**
+ * @brief Send a packet gathered from separate buffers over I2C
+ * 
+ * @param address: i2c_addr_t, i2c address
+ * @param iov: const i2c_iovec_t*, segments of the packet in order
+ * @param count: unsigned int, number of segments, at most I2C_IOV_MAX
+ * 
+ * @return status: SUCCESS_RETURN if success, ERROR_RETURN if error
+ *
+ * As send_packet, but the header, opcode, payload and tag of a message
+ * can stay in their own buffers. Large segments are sent in place
 */
-int send_packet(i2c_addr_t address, uint8_t len, uint8_t* packet) {
+RAMFUNC int send_packetv(i2c_addr_t address, const i2c_iovec_t* iov, unsigned int count) {
 
     int result;
+#if BOARD_LINK_FRAMED_WRITES
+    uint8_t index = address & 0x7F;
+
+    // Do not overrun the component's mailbox
+    if ((uint8_t)(tx_seq[index] - rx_seq[index]) >= BOARD_LINK_MAILBOX_DEPTH) {
+        return ERROR_RETURN;
+    }
+
+    // Committing the frame also acknowledges every reply consumed so far
+    result = i2c_simple_write_receive_framev(address, rx_seq[index] - 1,
+                                             tx_seq[index], iov, count);
+    if (result < SUCCESS_RETURN) {
+        return ERROR_RETURN;
+    }
+    tx_seq[index]++;
+    ack_pending[index] = false;
+#else
+    unsigned int len = 0;
+    for (unsigned int i = 0; i < count; i++) {
+        len += iov[i].len;
+    }
+    if (len > UINT8_MAX) {
+        return ERROR_RETURN;
+    }
     result = i2c_simple_write_receive_len(address, len);
     if (result < SUCCESS_RETURN) {
         return ERROR_RETURN;
     }
-    result = i2c_simple_write_data_generic(address, RECEIVE, len, packet);
+    result = i2c_simple_write_data_genericv(address, RECEIVE, iov, count);
     if (result < SUCCESS_RETURN) {
         return ERROR_RETURN;
     }
@@ -63,44 +171,213 @@ int send_packet(i2c_addr_t address, uint8_t len, uint8_t* packet) {
     if (result < SUCCESS_RETURN) {
         return ERROR_RETURN;
     }
+#endif
 
     return SUCCESS_RETURN;
 }
 
 /**
- * @brief Poll a component and receive a packet
+ * @brief Receive a packet if a component has one ready
  * 
  * @param address: i2c_addr_t, i2c address
  * @param packet: uint8_t*, pointer to a buffer where a packet will be received 
  * 
- * @return int: size of data received, ERROR_RETURN if error
+ * @return int: size of data received, NOT_READY_RETURN if no packet is
+ *   ready yet, ERROR_RETURN if error
+ *
+ * A single TRANSMIT_FRAME read returns the done flag, the sequence, the
+ * length and the first BOARD_LINK_PREFETCH_LEN bytes of the payload.
+ * Longer payloads are completed with one read of TRANSMIT. Replies are
+ * returned in the order the packets were sent. On error every command
+ * outstanding to the address is given up
 */
-int poll_and_receive_packet(i2c_addr_t address, uint8_t* packet) {
+RAMFUNC int try_receive_packet(i2c_addr_t address, uint8_t* packet) {
+    int result;
+    uint8_t frame[3 + BOARD_LINK_PREFETCH_LEN];
 
-    int result = SUCCESS_RETURN;
-    while (true) {
-        result = i2c_simple_read_transmit_done(address);
+    // A reply was consumed without a command since, acknowledge it now
+    // so the component can stage the next one
+    if (ack_pending[address & 0x7F]) {
+        result = i2c_simple_write_transmit_done(address, true);
         if (result < SUCCESS_RETURN) {
+            give_up_outstanding(address);
             return ERROR_RETURN;
         }
-        else if (result == SUCCESS_RETURN) {
-            break;
-        }
-        MXC_Delay(50);
+        ack_pending[address & 0x7F] = false;
     }
 
-    int len = i2c_simple_read_transmit_len(address);
-    if (len < SUCCESS_RETURN) {
-        return ERROR_RETURN;
-    }
-    result = i2c_simple_read_data_generic(address, TRANSMIT, (uint8_t)len, packet);
+    result = i2c_simple_read_data_generic(address, TRANSMIT_FRAME, sizeof(frame), frame);
     if (result < SUCCESS_RETURN) {
+        give_up_outstanding(address);
         return ERROR_RETURN;
     }
+    // TRANSMIT_DONE is cleared by the component when a packet is ready
+    if (frame[0]) {
+        return NOT_READY_RETURN;
+    }
+
+    uint8_t seq = frame[1];
+    uint8_t len = frame[2];
+#if BOARD_LINK_FRAMED_WRITES
+    // Replies to commands that were given up on are skipped
+    if ((int8_t)(seq - rx_seq[address & 0x7F]) < 0) {
+        ack_pending[address & 0x7F] = true;
+        return NOT_READY_RETURN;
+    }
+    rx_seq[address & 0x7F] = seq + 1;
+#else
+    (void) seq;
+#endif
+
+    if (len <= BOARD_LINK_PREFETCH_LEN) {
+        memcpy(packet, &frame[3], len);
+    } else {
+        result = i2c_simple_read_data_generic(address, TRANSMIT, len, packet);
+        if (result < SUCCESS_RETURN) {
+            give_up_outstanding(address);
+            return ERROR_RETURN;
+        }
+    }
+
+#if BOARD_LINK_FRAMED_WRITES
+    ack_pending[address & 0x7F] = true;
+#else
     result = i2c_simple_write_transmit_done(address, true);
     if (result < SUCCESS_RETURN) {
+        give_up_outstanding(address);
         return ERROR_RETURN;
     }
+#endif
 
     return len;
 }
+
+/**
+ * @brief Start waiting for a reply from a component
+ * 
+ * @param address: i2c_addr_t, i2c address
+ * @param timeout_us: uint32_t, give up after this long, POLL_NO_TIMEOUT to wait forever
+ * @param state: poll_state_t*, poll state to initialize
+ *
+ * Schedules the first poll just before the response time learned for the
+ * address. Call right after the command has been sent
+*/
+void poll_begin(i2c_addr_t address, uint32_t timeout_us, poll_state_t* state) {
+    state->address = address;
+    state->start = timer_simple_ticks();
+    state->next_poll_us = response_ewma_us[address & 0x7F] * POLL_LEAD_NUM / POLL_LEAD_DEN;
+    state->backoff_us = POLL_MIN_BACKOFF_US;
+    state->timeout_us = timeout_us;
+    state->learn = true;
+}
+
+/**
+ * @brief Start waiting for a reply that is ready right away
+ * 
+ * @param address: i2c_addr_t, i2c address
+ * @param timeout_us: uint32_t, give up after this long, POLL_NO_TIMEOUT to wait forever
+ * @param state: poll_state_t*, poll state to initialize
+ *
+ * For commands the component answers from its I2C interrupt. The first
+ * poll is due immediately and the response time is not learned from it
+*/
+void poll_begin_immediate(i2c_addr_t address, uint32_t timeout_us, poll_state_t* state) {
+    poll_begin(address, timeout_us, state);
+    state->next_poll_us = 0;
+    state->learn = false;
+}
+
+/**
+ * @brief Time until the next scheduled poll
+ * 
+ * @param state: poll_state_t*, poll state
+ * 
+ * @return uint32_t: microseconds until the next poll is due, 0 if due now
+*/
+uint32_t poll_wait_us(poll_state_t* state) {
+    uint32_t elapsed = timer_simple_elapsed_us(state->start);
+    if (elapsed >= state->next_poll_us) {
+        return 0;
+    }
+    return state->next_poll_us - elapsed;
+}
+
+/**
+ * @brief Poll for a reply if a poll is due
+ * 
+ * @param state: poll_state_t*, poll state
+ * @param packet: uint8_t*, pointer to a buffer where a packet will be received 
+ * 
+ * @return int: size of data received, NOT_READY_RETURN if the poll is not
+ *   due or the reply is not ready, ERROR_RETURN if error or timeout
+ *
+ * On success the measured response time is folded into the per-address
+ * average, otherwise the next poll is backed off exponentially
+*/
+RAMFUNC int poll_receive_packet(poll_state_t* state, uint8_t* packet) {
+    if (poll_wait_us(state) > 0) {
+        return NOT_READY_RETURN;
+    }
+
+    int result = try_receive_packet(state->address, packet);
+    uint32_t elapsed = timer_simple_elapsed_us(state->start);
+
+    if (result == NOT_READY_RETURN) {
+        if (state->timeout_us != POLL_NO_TIMEOUT && elapsed >= state->timeout_us) {
+            give_up_outstanding(state->address);
+            return ERROR_RETURN;
+        }
+        state->next_poll_us = elapsed + state->backoff_us;
+        if (state->backoff_us < POLL_MAX_BACKOFF_US) {
+            state->backoff_us *= 2;
+        }
+        return NOT_READY_RETURN;
+    }
+
+    if (result >= SUCCESS_RETURN && state->learn) {
+        uint32_t* ewma = &response_ewma_us[state->address & 0x7F];
+        if (*ewma == 0) {
+            *ewma = elapsed;
+        } else {
+            *ewma = *ewma - (*ewma >> POLL_EWMA_SHIFT) + (elapsed >> POLL_EWMA_SHIFT);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Wait for a reply started with poll_begin
+ * 
+ * @param state: poll_state_t*, poll state
+ * @param packet: uint8_t*, pointer to a buffer where a packet will be received 
+ * 
+ * @return int: size of data received, ERROR_RETURN if error
+*/
+RAMFUNC int poll_wait_and_receive_packet(poll_state_t* state, uint8_t* packet) {
+    while (true) {
+        uint32_t wait = poll_wait_us(state);
+        if (wait > 0) {
+            MXC_Delay(wait);
+        }
+
+        int result = poll_receive_packet(state, packet);
+        if (result != NOT_READY_RETURN) {
+            return result;
+        }
+    }
+}
+
+/**
+ * @brief Poll a component and receive a packet
+ * 
+ * @param address: i2c_addr_t, i2c address
+ * @param timeout_us: uint32_t, give up after this long, POLL_NO_TIMEOUT to wait forever
+ * @param packet: uint8_t*, pointer to a buffer where a packet will be received 
+ * 
+ * @return int: size of data received, ERROR_RETURN if error
+*/
+int poll_and_receive_packet(i2c_addr_t address, uint32_t timeout_us, uint8_t* packet) {
+    poll_state_t state;
+    poll_begin(address, timeout_us, &state);
+    return poll_wait_and_receive_packet(&state, packet);
+}
@@ -1,7 +1,7 @@
 /**
  * @file host_messaging.c
  * @author Frederich Stine
- * @brief eCTF Host Messaging Implementation 
+ * @brief eCTF Host Messaging Implementation
  * @date 2024
  *
  * This source file is part of an example system for MITRE's 2024 Embedded System CTF (eCTF).
@@ -13,18 +13,198 @@
 
 #include "host_messaging.h"
 
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "board.h"
+#include "mxc_device.h"
+#include "mxc_errors.h"
+#include "uart.h"
+
+// Console output waiting for the UART. main only advances tx_head, the
+// DMA completion only advances tx_tail, both run freely and wrap
+static char tx_ring[HOST_TX_RING_SIZE];
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+// Bytes of the ring the UART is currently sending
+static volatile uint32_t tx_inflight = 0;
+static mxc_uart_req_t tx_req;
+static bool tx_dma_ready = false;
+static host_stats_t stats;
+
+// Digits of the hex encoder
+static const char hex_digits[] = "0123456789abcdef";
+
+static void host_tx_done(mxc_uart_req_t *req, int result);
+
+// Send the next contiguous run of the ring
+// Only runs from main with interrupts masked, never from the completion,
+// so tx_req is not reused while the driver may still hold it
+static void host_tx_start(void) {
+    if (tx_inflight != 0 || tx_head == tx_tail) {
+        return;
+    }
+
+    uint32_t start = tx_tail % HOST_TX_RING_SIZE;
+    uint32_t len = tx_head - tx_tail;
+    if (len > HOST_TX_RING_SIZE - start) {
+        len = HOST_TX_RING_SIZE - start;
+    }
+    tx_inflight = len;
+
+#if HOST_DMA_MODE
+    if (tx_dma_ready) {
+        memset(&tx_req, 0, sizeof(tx_req));
+        tx_req.uart = MXC_UART_GET_UART(CONSOLE_UART);
+        tx_req.txData = (uint8_t *) &tx_ring[start];
+        tx_req.txLen = len;
+        tx_req.callback = host_tx_done;
+        if (MXC_UART_TransactionDMA(&tx_req) == E_NO_ERROR) {
+            return;
+        }
+    }
+#endif
+
+    // No DMA, write the run out before returning
+    for (uint32_t i = 0; i < len; i++) {
+        MXC_UART_WriteCharacter(MXC_UART_GET_UART(CONSOLE_UART), tx_ring[start + i]);
+    }
+    host_tx_done(NULL, E_NO_ERROR);
+}
+
+// Completion of a run, release it. main starts the next one
+static void host_tx_done(mxc_uart_req_t *req, int result) {
+    tx_tail += tx_inflight;
+    tx_inflight = 0;
+}
+
+// Start sending from main without racing the DMA completion
+static void host_tx_kick(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    host_tx_start();
+    __set_PRIMASK(primask);
+}
+
+// Start streaming console output by DMA. Output queued before this
+// call is written to the UART before returning from each message
+// The auto handlers of the MSDK UART driver only forward the DMA
+// interrupts of their channels to MXC_DMA_Handler, the same handler
+// i2c_simple_controller_init installs on DMA0-3, so the completion is
+// delivered whichever of the two set the vector last
+void host_messaging_init(void) {
+#if HOST_DMA_MODE
+    host_flush();
+    tx_dma_ready = MXC_UART_SetAutoDMAHandlers(MXC_UART_GET_UART(CONSOLE_UART), true) == E_NO_ERROR;
+#endif
+}
+
+// Queue raw bytes for the console
+void host_write(const char *data, size_t len) {
+    stats.queued += len;
+    while (len > 0) {
+        uint32_t space = HOST_TX_RING_SIZE - (tx_head - tx_tail);
+        if (space == 0) {
+            // Ring is full, wait for the UART to drain a run
+            stats.stalls++;
+            while (tx_head - tx_tail == HOST_TX_RING_SIZE) {
+                host_tx_kick();
+            }
+            continue;
+        }
+
+        uint32_t start = tx_head % HOST_TX_RING_SIZE;
+        uint32_t count = len < space ? len : space;
+        if (count > HOST_TX_RING_SIZE - start) {
+            count = HOST_TX_RING_SIZE - start;
+        }
+        memcpy(&tx_ring[start], data, count);
+        tx_head += count;
+        data += count;
+        len -= count;
+    }
+    host_tx_kick();
+}
+
+// Wait until every queued byte has left the UART
+void host_flush(void) {
+    stats.flushes++;
+    fflush(stdout);
+    while (tx_head != tx_tail) {
+        host_tx_kick();
+    }
+    while (MXC_UART_ReadyForSleep(MXC_UART_GET_UART(CONSOLE_UART)) != E_NO_ERROR);
+}
+
+// Queue a message of the given type, as "%type: message%"
+void host_print(const char *type, const char *fmt, ...) {
+    char line[HOST_LINE_MAX];
+    va_list args;
+
+    host_write("%", 1);
+    host_write(type, strlen(type));
+    host_write(": ", 2);
+
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (len >= (int) sizeof(line)) {
+        // Too long for the line buffer, send it through stdio after the queue
+        host_flush();
+        va_start(args, fmt);
+        vprintf(fmt, args);
+        va_end(args);
+        fflush(stdout);
+    } else if (len > 0) {
+        host_write(line, len);
+    }
+
+    host_write("%", 1);
+}
+
+// Queue a buffer of bytes as a hex string message of the given type
+void host_print_hex(const char *type, uint8_t *buf, size_t len) {
+    host_write("%", 1);
+    host_write(type, strlen(type));
+    host_write(": ", 2);
+    print_hex(buf, len);
+    host_write("%", 1);
+}
+
+// Send the ack prompt and wait for it to leave the UART
+void host_ack(void) {
+    host_write("%ack%\n", 6);
+    host_flush();
+}
+
+// Get the console output accounting
+const host_stats_t* host_messaging_stats(void) {
+    return &stats;
+}
+
 // Print a message through USB UART and then receive a line over USB UART
 void recv_input(const char *msg, char *buf) {
     print_debug(msg);
-    fflush(0);
     print_ack();
     gets(buf);
-    puts("");
+    host_write("\n", 1);
 }
 
 // Prints a buffer of bytes as a hex string
+// Bytes are encoded from a table in chunks and queued a chunk at a time
 void print_hex(uint8_t *buf, size_t len) {
-    for (int i = 0; i < len; i++)
-    	printf("%02x", buf[i]);
-    printf("\n");
+    char chunk[64];
+
+    while (len > 0) {
+        size_t count = len < sizeof(chunk) / 2 ? len : sizeof(chunk) / 2;
+        for (size_t i = 0; i < count; i++) {
+            chunk[2 * i] = hex_digits[buf[i] >> 4];
+            chunk[2 * i + 1] = hex_digits[buf[i] & 0xf];
+        }
+        host_write(chunk, 2 * count);
+        buf += count;
+        len -= count;
+    }
+    host_write("\n", 1);
 }
@@ -14,10 +14,469 @@
 #if CRYPTO_EXAMPLE
 
 #include "simple_crypto.h"
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
-/******************************** FUNCTION PROTOTYPES ********************************/
+#include "crypto_zero.h"
+#if CRYPTO_AES_HW
+#include "simple_aes.h"
+#endif
+
+/******************************** FUNCTION DEFINITIONS ********************************/
+#if CRYPTO_AES_HW
+/** @brief Runs blocks through the AES engine
+ *
+ * @param ctx A pointer to the context holding the key
+ * @param type MXC_AES_ENCRYPT_EXT_KEY or MXC_AES_DECRYPT_EXT_KEY
+ * @param in A pointer to a buffer of length len containing the input
+ * @param len The length of the input. Must be a multiple of BLOCK_SIZE
+ * @param out A pointer to a buffer of length len for the output
+ *
+ * @return 0 on success, non-zero for other error
+ */
+static int aes_hw_ecb(sym_ctx_t *ctx, mxc_aes_enc_type_t type, const uint8_t *in, size_t len, uint8_t *out) {
+    return aes_simple_ecb(ctx->key, type, in, len, out);
+}
+
+/** @brief XORs a counter mode keystream from the AES engine into data
+ *
+ * @param ctx A pointer to the context holding the key
+ * @param counter A pointer to the BLOCK_SIZE (16 bytes) counter block,
+ *          left pointing at the next unused block
+ * @param width The number of trailing bytes that form the counter,
+ *          BLOCK_SIZE for CTR and 4 for GCM
+ * @param in A pointer to a buffer of length len containing the input
+ * @param len The length of the input, any length
+ * @param out A pointer to a buffer of length len for the output
+ *
+ * @return 0 on success, non-zero for other error
+ */
+static int aes_hw_ctr(sym_ctx_t *ctx, uint8_t *counter, int width, const uint8_t *in, size_t len, uint8_t *out) {
+    return aes_simple_ctr(ctx->key, counter, width, in, len, out);
+}
+
+/** @brief Builds the 4-bit GHASH table of a subkey
+ *
+ * @param ctx A pointer to the context receiving the table
+ * @param h A pointer to the BLOCK_SIZE (16 bytes) GHASH subkey
+ *
+ * Entry i is the product of the subkey and the nibble i, so ghash_mult
+ * handles four bits per lookup instead of one per shift
+ */
+static void ghash_table(sym_ctx_t *ctx, const uint8_t *h) {
+    uint64_t vh = 0, vl = 0;
+
+    for (int i = 0; i < 8; i++) {
+        vh = (vh << 8) | h[i];
+        vl = (vl << 8) | h[8 + i];
+    }
+
+    // Nibble 8 is the subkey itself, 4, 2 and 1 are successive
+    // multiplications by x, reducing by the GCM polynomial
+    ctx->gcm_hh[0] = 0;
+    ctx->gcm_hl[0] = 0;
+    ctx->gcm_hh[8] = vh;
+    ctx->gcm_hl[8] = vl;
+    for (int i = 4; i > 0; i >>= 1) {
+        uint64_t carry = vl & 1;
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ (carry ? 0xE100000000000000ULL : 0);
+        ctx->gcm_hh[i] = vh;
+        ctx->gcm_hl[i] = vl;
+    }
+
+    // The rest follow by linearity
+    for (int i = 2; i <= 8; i *= 2) {
+        for (int j = 1; j < i; j++) {
+            ctx->gcm_hh[i + j] = ctx->gcm_hh[i] ^ ctx->gcm_hh[j];
+            ctx->gcm_hl[i + j] = ctx->gcm_hl[i] ^ ctx->gcm_hl[j];
+        }
+    }
+}
+
+/** @brief Multiplies a GHASH accumulator by the subkey in GF(2^128)
+ *
+ * @param ctx A pointer to the context holding the GHASH table
+ * @param x A pointer to the BLOCK_SIZE (16 bytes) accumulator, replaced
+ *          by the product
+ *
+ * Works through the accumulator a nibble at a time from the last byte,
+ * folding the four bits shifted out back in with a reduction table
+ */
+static void ghash_mult(const sym_ctx_t *ctx, uint8_t *x) {
+    // Reduction of the nibble shifted out, aligned to the top 16 bits
+    static const uint16_t reduce[16] = {
+        0x0000, 0x1C20, 0x3840, 0x2460, 0x7080, 0x6CA0, 0x48C0, 0x54E0,
+        0xE100, 0xFD20, 0xD940, 0xC560, 0x9180, 0x8DA0, 0xA9C0, 0xB5E0,
+    };
+    uint8_t nibble = x[BLOCK_SIZE - 1] & 0x0F;
+    uint64_t zh = ctx->gcm_hh[nibble];
+    uint64_t zl = ctx->gcm_hl[nibble];
+
+    for (int i = BLOCK_SIZE - 1; i >= 0; i--) {
+        uint8_t lo = x[i] & 0x0F;
+        uint8_t hi = x[i] >> 4;
+        uint8_t rem;
+
+        if (i != BLOCK_SIZE - 1) {
+            rem = zl & 0x0F;
+            zl = (zh << 60) | (zl >> 4);
+            zh = (zh >> 4) ^ ((uint64_t)reduce[rem] << 48);
+            zh ^= ctx->gcm_hh[lo];
+            zl ^= ctx->gcm_hl[lo];
+        }
+        rem = zl & 0x0F;
+        zl = (zh << 60) | (zl >> 4);
+        zh = (zh >> 4) ^ ((uint64_t)reduce[rem] << 48);
+        zh ^= ctx->gcm_hh[hi];
+        zl ^= ctx->gcm_hl[hi];
+    }
+
+    for (int i = 0; i < 8; i++) {
+        x[i] = zh >> (56 - 8 * i);
+        x[8 + i] = zl >> (56 - 8 * i);
+    }
+}
+
+/** @brief Absorbs data into a GHASH accumulator
+ *
+ * @param ctx A pointer to the context holding the GHASH table
+ * @param y A pointer to the BLOCK_SIZE (16 bytes) accumulator
+ * @param data A pointer to a buffer of length len containing the data
+ * @param len The length of the data, a partial last block is zero padded
+ */
+static void ghash_update(const sym_ctx_t *ctx, uint8_t *y, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        size_t n = len < BLOCK_SIZE ? len : BLOCK_SIZE;
+        for (size_t i = 0; i < n; i++)
+            y[i] ^= data[i];
+        ghash_mult(ctx, y);
+        data += n;
+        len -= n;
+    }
+}
+
+/** @brief Computes a GCM tag on the AES engine
+ *
+ * @param ctx A pointer to the context holding the key and GHASH subkey
+ * @param j0 A pointer to the BLOCK_SIZE (16 bytes) pre-counter block
+ * @param aad A pointer to a buffer of length aad_len containing the
+ *          authenticated data
+ * @param aad_len The length of aad
+ * @param ciphertext A pointer to a buffer of length len containing the ciphertext
+ * @param len The length of the ciphertext
+ * @param tag A pointer to a buffer of length GCM_TAG_SIZE (16 bytes) for the tag
+ *
+ * @return 0 on success, non-zero for other error
+ */
+static int aes_hw_gcm_tag(sym_ctx_t *ctx, const uint8_t *j0, const uint8_t *aad, size_t aad_len,
+                          const uint8_t *ciphertext, size_t len, uint8_t *tag) {
+    uint8_t y[BLOCK_SIZE] = {0};
+    uint8_t lengths[BLOCK_SIZE];
+    uint64_t aad_bits = (uint64_t)aad_len * 8;
+    uint64_t ct_bits = (uint64_t)len * 8;
+
+    ghash_update(ctx, y, aad, aad_len);
+    ghash_update(ctx, y, ciphertext, len);
+    for (int i = 0; i < 8; i++) {
+        lengths[i] = aad_bits >> (56 - 8 * i);
+        lengths[8 + i] = ct_bits >> (56 - 8 * i);
+    }
+    ghash_update(ctx, y, lengths, BLOCK_SIZE);
+
+    // The tag is GHASH masked with the encrypted pre-counter block
+    int result = aes_hw_ecb(ctx, MXC_AES_ENCRYPT_EXT_KEY, j0, BLOCK_SIZE, tag);
+    for (int i = 0; i < GCM_TAG_SIZE; i++)
+        tag[i] ^= y[i];
+    return result;
+}
+#endif
+
+/** @brief Expands a symmetric key into a context
+ *
+ * @param ctx A pointer to the context to set up
+ * @param key A pointer to a buffer of length KEY_SIZE (16 bytes) containing
+ *          the key
+ *
+ * @return 0 on success, non-zero for other error
+ */
+int sym_ctx_init(sym_ctx_t *ctx, uint8_t *key) {
+    int result; // Library result
+
+#if CRYPTO_AES_HW
+    result = aes_simple_init();
+    if (result != 0)
+        return result; // Report error
+
+    // The engine expands the key itself, only the GHASH subkey
+    // E(K, 0) is derived up front and expanded into its table
+    uint8_t h[BLOCK_SIZE] = {0};
+    memcpy(ctx->key, key, KEY_SIZE);
+    result = aes_hw_ecb(ctx, MXC_AES_ENCRYPT_EXT_KEY, h, BLOCK_SIZE, h);
+    if (result == 0)
+        ghash_table(ctx, h);
+    else
+        sym_ctx_free(ctx);
+    crypto_zero(h, sizeof(h));
+    return result;
+#else
+    result = wc_AesInit(&ctx->encrypt, NULL, INVALID_DEVID);
+    if (result != 0)
+        return result; // Report error
+    result = wc_AesInit(&ctx->decrypt, NULL, INVALID_DEVID);
+    if (result != 0) {
+        wc_AesFree(&ctx->encrypt);
+        return result; // Report error
+    }
+
+    // Expand the key once for each direction, the GCM key also sets
+    // the encrypt schedule used by the other modes
+    result = wc_AesGcmSetKey(&ctx->encrypt, key, KEY_SIZE);
+    if (result == 0)
+        result = wc_AesSetKey(&ctx->decrypt, key, KEY_SIZE, NULL, AES_DECRYPTION);
+    if (result != 0)
+        sym_ctx_free(ctx);
+    return result;
+#endif
+}
+
+/** @brief Expands a symmetric key for one direction only
+ *
+ * @param ctx A pointer to the context to set up
+ * @param key A pointer to a buffer of length KEY_SIZE (16 bytes) containing
+ *          the key
+ * @param dir AES_ENCRYPTION or AES_DECRYPTION
+ *
+ * @return 0 on success, non-zero for other error
+ *
+ * For the one-shot calls. Only the schedule for dir is expanded and the
+ * GCM tables are skipped, so the context only serves encrypt_sym_ctx or
+ * decrypt_sym_ctx matching dir. Release with sym_ctx_free
+ */
+static int sym_ctx_init_dir(sym_ctx_t *ctx, uint8_t *key, int dir) {
+    int result; // Library result
+
+    memset(ctx, 0, sizeof(*ctx));
+#if CRYPTO_AES_HW
+    (void)dir;
+    result = aes_simple_init();
+    if (result != 0)
+        return result; // Report error
+    memcpy(ctx->key, key, KEY_SIZE);
+    return 0;
+#else
+    Aes *aes = dir == AES_ENCRYPTION ? &ctx->encrypt : &ctx->decrypt;
+
+    result = wc_AesInit(aes, NULL, INVALID_DEVID);
+    if (result != 0)
+        return result; // Report error
+    result = wc_AesSetKey(aes, key, KEY_SIZE, NULL, dir);
+    if (result != 0)
+        sym_ctx_free(ctx);
+    return result;
+#endif
+}
+
+/** @brief Releases a context set up by sym_ctx_init
+ *
+ * @param ctx A pointer to the context to release. The key schedules
+ *          are cleared
+ */
+void sym_ctx_free(sym_ctx_t *ctx) {
+#if !CRYPTO_AES_HW
+    wc_AesFree(&ctx->encrypt);
+    wc_AesFree(&ctx->decrypt);
+#endif
+    crypto_zero(ctx, sizeof(*ctx));
+}
+
+/** @brief Encrypts plaintext using the key of a context
+ *
+ * @param ctx A pointer to a context set up by sym_ctx_init
+ * @param plaintext A pointer to a buffer of length len containing the
+ *          plaintext to encrypt
+ * @param len The length of the plaintext to encrypt. Must be a multiple of
+ *          BLOCK_SIZE (16 bytes)
+ * @param ciphertext A pointer to a buffer of length len where the resulting
+ *          ciphertext will be written to
+ *
+ * @return 0 on success, -1 on bad length, other non-zero for other error
+ */
+int encrypt_sym_ctx(sym_ctx_t *ctx, uint8_t *plaintext, size_t len, uint8_t *ciphertext) {
+    // Ensure valid length
+    if (len == 0 || len % BLOCK_SIZE)
+        return -1;
+
+#if CRYPTO_AES_HW
+    return aes_hw_ecb(ctx, MXC_AES_ENCRYPT_EXT_KEY, plaintext, len, ciphertext);
+#else
+    int result; // Library result
+
+    // Encrypt each block
+    for (size_t i = 0; i < len; i += BLOCK_SIZE) {
+        result = wc_AesEncryptDirect(&ctx->encrypt, ciphertext + i, plaintext + i);
+        if (result != 0)
+            return result; // Report error
+    }
+    return 0;
+#endif
+}
+
+/** @brief Decrypts ciphertext using the key of a context
+ *
+ * @param ctx A pointer to a context set up by sym_ctx_init
+ * @param ciphertext A pointer to a buffer of length len containing the
+ *          ciphertext to decrypt
+ * @param len The length of the ciphertext to decrypt. Must be a multiple of
+ *          BLOCK_SIZE (16 bytes)
+ * @param plaintext A pointer to a buffer of length len where the resulting
+ *          plaintext will be written to
+ *
+ * @return 0 on success, -1 on bad length, other non-zero for other error
+ */
+int decrypt_sym_ctx(sym_ctx_t *ctx, uint8_t *ciphertext, size_t len, uint8_t *plaintext) {
+    // Ensure valid length
+    if (len == 0 || len % BLOCK_SIZE)
+        return -1;
+
+#if CRYPTO_AES_HW
+    return aes_hw_ecb(ctx, MXC_AES_DECRYPT_EXT_KEY, ciphertext, len, plaintext);
+#else
+    int result; // Library result
+
+    // Decrypt each block
+    for (size_t i = 0; i < len; i += BLOCK_SIZE) {
+        result = wc_AesDecryptDirect(&ctx->decrypt, plaintext + i, ciphertext + i);
+        if (result != 0)
+            return result; // Report error
+    }
+    return 0;
+#endif
+}
+
+/** @brief Encrypts or decrypts data in counter mode
+ *
+ * @param ctx A pointer to a context set up by sym_ctx_init
+ * @param iv A pointer to a buffer of length BLOCK_SIZE (16 bytes) containing
+ *          the initial counter block. Must never repeat under one key
+ * @param in A pointer to a buffer of length len containing the data
+ * @param len The length of the data, any length
+ * @param out A pointer to a buffer of length len where the result will be
+ *          written to. May be the same as in
+ *
+ * @return 0 on success, non-zero for other error
+ */
+int crypt_ctr(sym_ctx_t *ctx, uint8_t *iv, uint8_t *in, size_t len, uint8_t *out) {
+    if (len == 0)
+        return 0;
+
+#if CRYPTO_AES_HW
+    uint8_t counter[BLOCK_SIZE];
+    memcpy(counter, iv, BLOCK_SIZE);
+    return aes_hw_ctr(ctx, counter, BLOCK_SIZE, in, len, out);
+#else
+    // Restart the keystream at the caller's counter block
+    int result = wc_AesSetIV(&ctx->encrypt, iv);
+    if (result != 0)
+        return result; // Report error
+    ctx->encrypt.left = 0;
+    return wc_AesCtrEncrypt(&ctx->encrypt, out, in, len);
+#endif
+}
+
+/** @brief Encrypts and authenticates plaintext in GCM
+ *
+ * @param ctx A pointer to a context set up by sym_ctx_init
+ * @param iv A pointer to a buffer of length GCM_IV_SIZE (12 bytes) containing
+ *          the nonce. Must never repeat under one key
+ * @param aad A pointer to a buffer of length aad_len containing data that
+ *          is authenticated but not encrypted, may be NULL if aad_len is 0
+ * @param aad_len The length of aad
+ * @param plaintext A pointer to a buffer of length len containing the
+ *          plaintext to encrypt
+ * @param len The length of the plaintext, any length
+ * @param ciphertext A pointer to a buffer of length len where the resulting
+ *          ciphertext will be written to
+ * @param tag A pointer to a buffer of length GCM_TAG_SIZE (16 bytes) where
+ *          the authentication tag will be written to
+ *
+ * @return 0 on success, non-zero for other error
+ */
+int encrypt_gcm(sym_ctx_t *ctx, uint8_t *iv, uint8_t *aad, size_t aad_len,
+                uint8_t *plaintext, size_t len, uint8_t *ciphertext, uint8_t *tag) {
+#if CRYPTO_AES_HW
+    uint8_t j0[BLOCK_SIZE] = {0};
+    uint8_t counter[BLOCK_SIZE];
+    int result; // Driver result
+
+    // Pre-counter block is the nonce followed by a counter of 1,
+    // the payload keystream starts one block later
+    memcpy(j0, iv, GCM_IV_SIZE);
+    j0[BLOCK_SIZE - 1] = 1;
+    memcpy(counter, j0, BLOCK_SIZE);
+    aes_simple_ctr_increment(counter, 4);
+
+    result = aes_hw_ctr(ctx, counter, 4, plaintext, len, ciphertext);
+    if (result != 0)
+        return result; // Report error
+    return aes_hw_gcm_tag(ctx, j0, aad, aad_len, ciphertext, len, tag);
+#else
+    return wc_AesGcmEncrypt(&ctx->encrypt, ciphertext, plaintext, len, iv, GCM_IV_SIZE,
+                            tag, GCM_TAG_SIZE, aad, aad_len);
+#endif
+}
+
+/** @brief Authenticates and decrypts ciphertext in GCM
+ *
+ * @param ctx A pointer to a context set up by sym_ctx_init
+ * @param iv A pointer to a buffer of length GCM_IV_SIZE (12 bytes) containing
+ *          the nonce used for encryption
+ * @param aad A pointer to a buffer of length aad_len containing the
+ *          authenticated data, may be NULL if aad_len is 0
+ * @param aad_len The length of aad
+ * @param ciphertext A pointer to a buffer of length len containing the
+ *          ciphertext to decrypt
+ * @param len The length of the ciphertext, any length
+ * @param tag A pointer to a buffer of length GCM_TAG_SIZE (16 bytes) containing
+ *          the authentication tag
+ * @param plaintext A pointer to a buffer of length len where the resulting
+ *          plaintext will be written to. Must be discarded if
+ *          authentication fails
+ *
+ * @return 0 on success, -1 on authentication failure, other non-zero for other error
+ */
+int decrypt_gcm(sym_ctx_t *ctx, uint8_t *iv, uint8_t *aad, size_t aad_len,
+                uint8_t *ciphertext, size_t len, uint8_t *tag, uint8_t *plaintext) {
+#if CRYPTO_AES_HW
+    uint8_t j0[BLOCK_SIZE] = {0};
+    uint8_t counter[BLOCK_SIZE];
+    uint8_t expected[GCM_TAG_SIZE];
+    uint8_t diff = 0;
+    int result; // Driver result
+
+    memcpy(j0, iv, GCM_IV_SIZE);
+    j0[BLOCK_SIZE - 1] = 1;
+
+    // Check the tag over the ciphertext before decrypting anything
+    result = aes_hw_gcm_tag(ctx, j0, aad, aad_len, ciphertext, len, expected);
+    if (result != 0)
+        return result; // Report error
+    for (int i = 0; i < GCM_TAG_SIZE; i++)
+        diff |= expected[i] ^ tag[i];
+    if (diff != 0)
+        return -1;
+
+    memcpy(counter, j0, BLOCK_SIZE);
+    aes_simple_ctr_increment(counter, 4);
+    return aes_hw_ctr(ctx, counter, 4, ciphertext, len, plaintext);
+#else
+    int result = wc_AesGcmDecrypt(&ctx->encrypt, plaintext, ciphertext, len, iv, GCM_IV_SIZE,
+                                  tag, GCM_TAG_SIZE, aad, aad_len);
+    return result == AES_GCM_AUTH_E ? -1 : result;
+#endif
+}
+
 /** @brief Encrypts plaintext using a symmetric cipher
  *
  * @param plaintext A pointer to a buffer of length len containing the
@@ -30,28 +489,25 @@
  *          ciphertext will be written to
  *
  * @return 0 on success, -1 on bad length, other non-zero for other error
+ *
+ * Expands the key on every call, use encrypt_sym_ctx for repeated
+ * messages under the same key
  */
 int encrypt_sym(uint8_t *plaintext, size_t len, uint8_t *key, uint8_t *ciphertext) {
-    Aes ctx; // Context for encryption
+    sym_ctx_t ctx; // Context for encryption
     int result; // Library result
 
     // Ensure valid length
-    if (len <= 0 || len % BLOCK_SIZE)
+    if (len == 0 || len % BLOCK_SIZE)
         return -1;
 
-    // Set the key for encryption
-    result = wc_AesSetKey(&ctx, key, 16, NULL, AES_ENCRYPTION);
+    result = sym_ctx_init_dir(&ctx, key, AES_ENCRYPTION);
     if (result != 0)
         return result; // Report error
 
-
-    // Encrypt each block
-    for (int i = 0; i < len - 1; i += BLOCK_SIZE) {
-        result = wc_AesEncryptDirect(&ctx, ciphertext + i, plaintext + i);
-        if (result != 0)
-            return result; // Report error
-    }
-    return 0;
+    result = encrypt_sym_ctx(&ctx, plaintext, len, ciphertext);
+    sym_ctx_free(&ctx);
+    return result;
 }
 
 /** @brief Decrypts ciphertext using a symmetric cipher
@@ -66,27 +522,25 @@ int encrypt_sym(uint8_t *plaintext, size_t len, uint8_t *key, uint8_t *ciphertex
  *          plaintext will be written to
  *
  * @return 0 on success, -1 on bad length, other non-zero for other error
+ *
+ * Expands the key on every call, use decrypt_sym_ctx for repeated
+ * messages under the same key
  */
 int decrypt_sym(uint8_t *ciphertext, size_t len, uint8_t *key, uint8_t *plaintext) {
-    Aes ctx; // Context for decryption
+    sym_ctx_t ctx; // Context for decryption
     int result; // Library result
 
     // Ensure valid length
-    if (len <= 0 || len % BLOCK_SIZE)
+    if (len == 0 || len % BLOCK_SIZE)
         return -1;
 
-    // Set the key for decryption
-    result = wc_AesSetKey(&ctx, key, 16, NULL, AES_DECRYPTION);
+    result = sym_ctx_init_dir(&ctx, key, AES_DECRYPTION);
     if (result != 0)
         return result; // Report error
 
-    // Decrypt each block
-    for (int i = 0; i < len - 1; i += BLOCK_SIZE) {
-        result = wc_AesDecryptDirect(&ctx, plaintext + i, ciphertext + i);
-        if (result != 0)
-            return result; // Report error
-    }
-    return 0;
+    result = decrypt_sym_ctx(&ctx, ciphertext, len, plaintext);
+    sym_ctx_free(&ctx);
+    return result;
 }
 
 /** @brief Hashes arbitrary-length data
@@ -104,4 +558,96 @@ int hash(void *data, size_t len, uint8_t *hash_out) {
     return wc_Md5Hash((uint8_t *)data, len, hash_out);
 }
 
+/** @brief Sets up a hash context
+ *
+ * @param ctx A pointer to the context to set up
+ * @param alg The hash algorithm to use
+ *
+ * @return 0 on success, -1 on unknown algorithm, other non-zero for other error
+ */
+int hash_ctx_init(hash_ctx_t *ctx, hash_alg_t alg) {
+    ctx->alg = alg;
+    switch (alg) {
+    case HASH_MD5:
+        return wc_InitMd5(&ctx->md5);
+    case HASH_SHA256:
+        return wc_InitSha256(&ctx->sha256);
+    default:
+        return -1;
+    }
+}
+
+/** @brief Releases a context set up by hash_ctx_init
+ *
+ * @param ctx A pointer to the context to release
+ */
+void hash_ctx_free(hash_ctx_t *ctx) {
+    if (ctx->alg == HASH_SHA256)
+        wc_Sha256Free(&ctx->sha256);
+    else
+        wc_Md5Free(&ctx->md5);
+}
+
+/** @brief Digest length of a hash context
+ *
+ * @param ctx A pointer to a context set up by hash_ctx_init
+ *
+ * @return The number of bytes hash_ctx_final writes
+ */
+size_t hash_ctx_size(hash_ctx_t *ctx) {
+    return ctx->alg == HASH_SHA256 ? WC_SHA256_DIGEST_SIZE : MD5_DIGEST_SIZE;
+}
+
+/** @brief Feeds data into a hash context
+ *
+ * @param ctx A pointer to a context set up by hash_ctx_init
+ * @param data A pointer to a buffer of length len containing the next
+ *          part of the message. May point straight into flash
+ * @param len The length of the data
+ *
+ * @return 0 on success, non-zero for other error
+ */
+int hash_ctx_update(hash_ctx_t *ctx, const void *data, size_t len) {
+    if (ctx->alg == HASH_SHA256)
+        return wc_Sha256Update(&ctx->sha256, (const uint8_t *)data, len);
+    return wc_Md5Update(&ctx->md5, (const uint8_t *)data, len);
+}
+
+/** @brief Finishes the digest of a hash context
+ *
+ * @param ctx A pointer to a context set up by hash_ctx_init
+ * @param hash_out A pointer to a buffer of length hash_ctx_size(ctx) where
+ *          the resulting hash output will be written to
+ *
+ * @return 0 on success, non-zero for other error
+ *
+ * The context is reset and can be reused for the next message
+ */
+int hash_ctx_final(hash_ctx_t *ctx, uint8_t *hash_out) {
+    // Final also resets the state for the next digest
+    if (ctx->alg == HASH_SHA256)
+        return wc_Sha256Final(&ctx->sha256, hash_out);
+    return wc_Md5Final(&ctx->md5, hash_out);
+}
+
+/** @brief Hashes arbitrary-length data using a context
+ *
+ * @param ctx A pointer to a context set up by hash_ctx_init
+ * @param data A pointer to a buffer of length len containing the data
+ *          to be hashed
+ * @param len The length of the data to hash
+ * @param hash_out A pointer to a buffer of length hash_ctx_size(ctx) where
+ *          the resulting hash output will be written to
+ *
+ * @return 0 on success, non-zero for other error
+ */
+int hash_ctx(hash_ctx_t *ctx, void *data, size_t len, uint8_t *hash_out) {
+    int result; // Library result
+
+    result = hash_ctx_update(ctx, data, len);
+    if (result != 0)
+        return result; // Report error
+    return hash_ctx_final(ctx, hash_out);
+}
+
 #endif
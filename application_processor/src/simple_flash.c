@@ -13,14 +13,43 @@
 
 #include "simple_flash.h"
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "flc.h"
 #include "icc.h"
 #include "nvic_table.h"
 
-#include <stdio.h>
+/******************************** GLOBAL DEFINITIONS ********************************/
+// Records that fit in one journal page, the first one is the header
+#define JOURNAL_SLOTS (MXC_FLASH_PAGE_SIZE / FLASH_JOURNAL_RECORD_SIZE)
+
+// Journal state, words is the RAM copy the journal replays into
+static uint32_t journal_base;
+static uint32_t* journal_words;
+static uint32_t journal_count;
+static int journal_page = -1;
+static uint32_t journal_slot;
+static uint32_t journal_seq;
+
+// Erase state of the spare journal page
+typedef enum {
+    SPARE_UNKNOWN,
+    SPARE_DIRTY,
+    SPARE_ERASED,
+} journal_spare_state_t;
+static journal_spare_state_t journal_spare = SPARE_UNKNOWN;
+
+// Whether the instruction cache runs outside of flash erase and write
+#if BENCHMARK_ICC_OFF
+static bool icc_enabled = false;
+#else
+static bool icc_enabled = true;
+#endif
 
+/******************************** FUNCTION DEFINITIONS ********************************/
 /**
  * @brief ISR for the Flash Controller
  * 
@@ -44,14 +73,42 @@ void flash_simple_irq(void) {
  * @brief Initialize the Simple Flash Interface
  * 
  * This function registers the interrupt for the flash system,
- * enables the interrupt, and disables ICC
+ * enables the interrupt, and enables ICC. The cache is only
+ * disabled while a page is erased or written
 */
 void flash_simple_init(void) {
     // Setup Flash
     MXC_NVIC_SetVector(FLC0_IRQn, flash_simple_irq);
     NVIC_EnableIRQ(FLC0_IRQn);
     MXC_FLC_EnableInt(MXC_F_FLC_INTR_DONEIE | MXC_F_FLC_INTR_AFIE);
-    MXC_ICC_Disable(MXC_ICC0);
+    if (icc_enabled) {
+        MXC_ICC_Enable(MXC_ICC0);
+    } else {
+        MXC_ICC_Disable(MXC_ICC0);
+    }
+}
+
+/**
+ * @brief Disable ICC ahead of a flash erase or write
+ * 
+ * The cache must not serve lines from a page while it is being changed
+*/
+static void flash_simple_icc_suspend(void) {
+    if (icc_enabled) {
+        MXC_ICC_Disable(MXC_ICC0);
+    }
+}
+
+/**
+ * @brief Re-enable ICC after a flash erase or write
+ * 
+ * The cache is flushed first so no line from before the change survives
+*/
+static void flash_simple_icc_resume(void) {
+    if (icc_enabled) {
+        MXC_ICC_Flush(MXC_ICC0);
+        MXC_ICC_Enable(MXC_ICC0);
+    }
 }
 
 /**
@@ -67,7 +124,10 @@ void flash_simple_init(void) {
  * In order to be re-written the entire page must be erased.
 */
 int flash_simple_erase_page(uint32_t address) {
-    return MXC_FLC_PageErase(address);
+    flash_simple_icc_suspend();
+    int ret = MXC_FLC_PageErase(address);
+    flash_simple_icc_resume();
+    return ret;
 }
 
 /**
@@ -99,5 +159,254 @@ void flash_simple_read(uint32_t address, uint32_t* buffer, uint32_t size) {
  * flash_simple_erase_page documentation.
 */
 int flash_simple_write(uint32_t address, uint32_t* buffer, uint32_t size) {
-    return MXC_FLC_Write(address, size, buffer);
+    flash_simple_icc_suspend();
+    int ret = MXC_FLC_Write(address, size, buffer);
+    flash_simple_icc_resume();
+    return ret;
+}
+
+/**
+ * @brief CRC-32 of a journal record
+ * 
+ * @param record: flash_journal_record*, record to check
+ * 
+ * @return uint32_t: CRC-32 of every field before crc
+*/
+static uint32_t journal_crc(const flash_journal_record* record) {
+    const uint8_t* data = (const uint8_t*) record;
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (unsigned i = 0; i < offsetof(flash_journal_record, crc); i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+/**
+ * @brief Address of a journal slot
+ * 
+ * @param page: int, journal page
+ * @param slot: uint32_t, record slot within the page
+ * 
+ * @return uint32_t: flash address of the slot
+*/
+static uint32_t journal_addr(int page, uint32_t slot) {
+    return journal_base + page * MXC_FLASH_PAGE_SIZE + slot * FLASH_JOURNAL_RECORD_SIZE;
+}
+
+/**
+ * @brief Check whether a record was never programmed
+ * 
+ * @param record: flash_journal_record*, record to check
+ * 
+ * @return bool: true if every byte is erased
+*/
+static bool journal_erased(const flash_journal_record* record) {
+    return record->seq == 0xFFFFFFFF && record->key == 0xFFFFFFFF &&
+           record->value == 0xFFFFFFFF && record->crc == 0xFFFFFFFF;
+}
+
+/**
+ * @brief Program one journal record
+ * 
+ * @param page: int, journal page
+ * @param slot: uint32_t, record slot within the page
+ * @param key: uint32_t, word index or FLASH_JOURNAL_HEADER_KEY
+ * @param value: uint32_t, value of the record
+ * 
+ * @return int: return negative if failure, zero if success
+*/
+static int journal_program(int page, uint32_t slot, uint32_t key, uint32_t value) {
+    flash_journal_record record = {
+        .seq = journal_seq++,
+        .key = key,
+        .value = value,
+    };
+    record.crc = journal_crc(&record);
+    return flash_simple_write(journal_addr(page, slot), (uint32_t*)&record, sizeof(record));
+}
+
+/**
+ * @brief Open the Flash Journal
+ * 
+ * @param base: uint32_t, address of the first of FLASH_JOURNAL_PAGES pages
+ * @param words: uint32_t*, RAM copy of the journaled words
+ * @param count: uint32_t, number of journaled words
+ * 
+ * @return int: return negative if no journal was found, zero if success
+ *
+ * Replays the live journal page into words. Words the journal never set
+ * are left erased (0xFFFFFFFF). If no journal is found the caller fills in
+ * words and creates one with flash_simple_journal_reset
+*/
+int flash_simple_journal_open(uint32_t base, uint32_t* words, uint32_t count) {
+    flash_journal_record record;
+    uint32_t header_seq = 0;
+
+    journal_base = base;
+    journal_words = words;
+    journal_count = count;
+    journal_page = -1;
+    journal_seq = 0;
+    journal_spare = SPARE_UNKNOWN;
+
+    // The live page is the one with the newest valid header
+    for (int page = 0; page < FLASH_JOURNAL_PAGES; page++) {
+        flash_simple_read(journal_addr(page, 0), (uint32_t*)&record, sizeof(record));
+        if (record.key != FLASH_JOURNAL_HEADER_KEY || record.value != FLASH_JOURNAL_MAGIC ||
+            record.crc != journal_crc(&record)) {
+            continue;
+        }
+        if (journal_page < 0 || record.seq > header_seq) {
+            journal_page = page;
+            header_seq = record.seq;
+        }
+    }
+
+    memset(words, 0xFF, count * sizeof(uint32_t));
+    if (journal_page < 0) {
+        return -1;
+    }
+
+    // Replay records in order up to the first erased slot. A record torn by
+    // a reset fails its CRC and is skipped, its slot is never reused
+    journal_seq = header_seq + 1;
+    for (journal_slot = 1; journal_slot < JOURNAL_SLOTS; journal_slot++) {
+        flash_simple_read(journal_addr(journal_page, journal_slot), (uint32_t*)&record, sizeof(record));
+        if (journal_erased(&record)) {
+            break;
+        }
+        if (record.crc != journal_crc(&record) || record.key >= count) {
+            continue;
+        }
+        words[record.key] = record.value;
+        if (record.seq >= journal_seq) {
+            journal_seq = record.seq + 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Flash Journal Reset
+ * 
+ * @return int: return negative if failure, zero if success
+ *
+ * Writes a snapshot of every word to the spare page and makes it the
+ * live journal. The header is written last so an interrupted reset
+ * leaves the previous journal in place. The spare page is only erased
+ * here if flash_simple_service has not erased it ahead of time
+*/
+int flash_simple_journal_reset(void) {
+    int spare = (journal_page + 1) % FLASH_JOURNAL_PAGES;
+
+    if (journal_words == NULL || journal_count >= JOURNAL_SLOTS) {
+        return -1;
+    }
+
+    // Normally flash_simple_service has erased the spare page already
+    if (journal_spare != SPARE_ERASED) {
+        if (flash_simple_erase_page(journal_addr(spare, 0)) != 0) {
+            return -1;
+        }
+    }
+    journal_spare = SPARE_DIRTY;
+    for (uint32_t i = 0; i < journal_count; i++) {
+        if (journal_program(spare, i + 1, i, journal_words[i]) != 0) {
+            return -1;
+        }
+    }
+    if (journal_program(spare, 0, FLASH_JOURNAL_HEADER_KEY, FLASH_JOURNAL_MAGIC) != 0) {
+        return -1;
+    }
+
+    // The previous page is the spare from now on
+    journal_page = spare;
+    journal_slot = journal_count + 1;
+    return 0;
+}
+
+/**
+ * @brief Flash Journal Write
+ * 
+ * @param index: uint32_t, index of the word to set
+ * @param value: uint32_t, new value of the word
+ * 
+ * @return int: return negative if failure, zero if success
+ *
+ * Appends a single record to the live page. Only when the page is full is
+ * the journal compacted into the spare page with flash_simple_journal_reset.
+ * The word in RAM is left unchanged on failure
+*/
+int flash_simple_journal_write(uint32_t index, uint32_t value) {
+    if (journal_page < 0 || index >= journal_count) {
+        return -1;
+    }
+
+    // A full page is compacted with the new value, the RAM copy is
+    // restored if the compaction fails
+    if (journal_slot >= JOURNAL_SLOTS) {
+        uint32_t previous = journal_words[index];
+        journal_words[index] = value;
+        if (flash_simple_journal_reset() != 0) {
+            journal_words[index] = previous;
+            return -1;
+        }
+        return 0;
+    }
+
+    // The RAM copy only changes once the record is in flash. A failed
+    // record that left its slot erased is retried in the same slot,
+    // replay stops at the first erased slot
+    if (journal_program(journal_page, journal_slot, index, value) != 0) {
+        flash_journal_record record;
+        flash_simple_read(journal_addr(journal_page, journal_slot), (uint32_t*)&record, sizeof(record));
+        if (!journal_erased(&record)) {
+            journal_slot++;
+        }
+        return -1;
+    }
+    journal_slot++;
+    journal_words[index] = value;
+    return 0;
+}
+
+/**
+ * @brief Flash Simple Service
+ *
+ * Erases the spare journal page ahead of time so the next compaction only
+ * has to program it. Call from the main loop while idle: the flash has a
+ * single bank, so instruction fetches stall for the whole erase and it
+ * must not land on the command path
+*/
+void flash_simple_service(void) {
+    if (journal_page < 0 || journal_spare == SPARE_ERASED) {
+        return;
+    }
+
+    int spare = (journal_page + 1) % FLASH_JOURNAL_PAGES;
+    uint32_t address = journal_addr(spare, 0);
+
+    // After open the spare page may already be blank
+    if (journal_spare == SPARE_UNKNOWN) {
+        const volatile uint32_t* word = (const volatile uint32_t*)(uintptr_t) address;
+        uint32_t i;
+        for (i = 0; i < MXC_FLASH_PAGE_SIZE / sizeof(uint32_t); i++) {
+            if (word[i] != 0xFFFFFFFF) {
+                break;
+            }
+        }
+        if (i == MXC_FLASH_PAGE_SIZE / sizeof(uint32_t)) {
+            journal_spare = SPARE_ERASED;
+            return;
+        }
+    }
+
+    if (flash_simple_erase_page(address) == 0) {
+        journal_spare = SPARE_ERASED;
+    }
 }
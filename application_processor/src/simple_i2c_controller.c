@@ -14,15 +14,72 @@
 
 #include "simple_i2c_controller.h"
 
+/******************************** GLOBAL DEFINITIONS ********************************/
+// Fixed pool of request descriptors
+static i2c_simple_req_t req_pool[I2C_REQ_POOL_SIZE];
+
+// FIFO of descriptors waiting for the bus, only touched from the main loop
+static int pending_queue[I2C_REQ_POOL_SIZE];
+static int pending_head = 0;
+static int pending_count = 0;
+
+// Descriptor currently on the bus, NULL if idle
+static i2c_simple_req_t* volatile active_req = NULL;
+
+// Negotiated speed and error accounting per address
+static i2c_speed_stats_t speed_stats[128];
+// Speed the bus is currently clocked at
+static i2c_speed_t bus_speed = I2C_SPEED_STANDARD;
+
+// Bus frequency for each speed
+static const unsigned int speed_hz[I2C_SPEED_COUNT] = {
+    [I2C_SPEED_STANDARD] = 100000,
+    [I2C_SPEED_FAST] = 400000,
+    [I2C_SPEED_FAST_PLUS] = 1000000,
+};
+
+// Completion queue, filled from the I2C interrupt and drained by the main loop
+static volatile int completion_queue[I2C_REQ_POOL_SIZE];
+static volatile unsigned completion_head = 0;
+static volatile unsigned completion_tail = 0;
+
+// DMA channel used to stream large write payloads
+static int tx_dma_ch = -1;
+// Payload bytes copied into descriptors and sent in place
+static i2c_copy_stats_t copy_stats;
+
+// Bus errors that end a DMA write early
+#define I2C_ERR_FLAGS (MXC_F_I2C_INTFL0_ADDR_NACK_ERR | MXC_F_I2C_INTFL0_DATA_ERR | \
+                       MXC_F_I2C_INTFL0_ARB_ERR | MXC_F_I2C_INTFL0_TO_ERR)
+
 /******************************** FUNCTION PROTOTYPES ********************************/
+/**
+ * @brief Built-In DMA Interrupt Handler
+ *
+ * Utilize the built-in DMA interrupt handler to complete
+ * MXC_I2C_MasterTransactionDMA() function calls
+ */
+static void DMA_Handler(void) { MXC_DMA_Handler(); }
+
 /**
  * @brief Built-In I2C Interrupt Handler
  *
  * Utilize the built-in I2C interrupt handler to allow for the use
- * of MXC_I2C_Master_Transaction() function calls
+ * of MXC_I2C_MasterTransactionAsync() function calls
  */
 static void I2C_Handler(void) { MXC_I2C_AsyncHandler(I2C_INTERFACE); }
 
+static int i2c_simple_alloc(i2c_addr_t addr, uint32_t tag, bool notify);
+static RAMFUNC void i2c_simple_callback(mxc_i2c_req_t* request, int result);
+static RAMFUNC int i2c_simple_wait(int index);
+static void i2c_simple_account(i2c_simple_req_t* req, int result);
+static int i2c_simple_start_dma_write(i2c_simple_req_t* req);
+static void i2c_simple_poll_dma_write(void);
+static int i2c_simple_iov_len(const i2c_iovec_t* iov, unsigned int count);
+static void i2c_simple_set_payload(i2c_simple_req_t* req, unsigned int header_len,
+                                   const i2c_iovec_t* iov, unsigned int count);
+static void i2c_simple_next_dma_segment(i2c_simple_req_t* req);
+
 /******************************** FUNCTION DEFINITIONS ********************************/
 /**
  * @brief Initialize the I2C Connection
@@ -46,9 +103,581 @@ int i2c_simple_controller_init(void) {
     MXC_NVIC_SetVector(MXC_I2C_GET_IRQ(MXC_I2C_GET_IDX(I2C_INTERFACE)), I2C_Handler);
     NVIC_EnableIRQ(MXC_I2C_GET_IRQ(MXC_I2C_GET_IDX(I2C_INTERFACE)));
 
+    // Reserve a DMA channel for large writes, the HAL takes its own
+    // channels for DMA reads from the ones after it
+    error = MXC_DMA_Init();
+    if (error != E_NO_ERROR) {
+        printf("Failed to initialize DMA.\n");
+        return error;
+    }
+    tx_dma_ch = MXC_DMA_AcquireChannel();
+    if (tx_dma_ch < 0) {
+        printf("Failed to acquire DMA channel.\n");
+        return E_NONE_AVAIL;
+    }
+    // Channels are dispatched by MXC_DMA_Handler, which also serves the
+    // console DMA channel of host_messaging
+    for (int irq = DMA0_IRQn; irq <= DMA3_IRQn; irq++) {
+        MXC_NVIC_SetVector(irq, DMA_Handler);
+        NVIC_EnableIRQ(irq);
+    }
+
+    return E_NO_ERROR;
+}
+
+/**
+ * @brief Allocate a request descriptor and queue it for the bus
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param tag: uint32_t, caller value returned with the completion
+ * @param notify: bool, post to the completion queue when done
+ * 
+ * @return int: descriptor index, E_NONE_AVAIL if the pool is exhausted
+ *
+ * The caller fills in the transfer fields of the HAL request
+ * before the engine is next serviced
+*/
+static int i2c_simple_alloc(i2c_addr_t addr, uint32_t tag, bool notify) {
+    for (int i = 0; i < I2C_REQ_POOL_SIZE; i++) {
+        i2c_simple_req_t* req = &req_pool[i];
+        if (req->state != I2C_REQ_FREE) {
+            continue;
+        }
+
+        req->request.i2c = I2C_INTERFACE;
+        req->request.addr = addr;
+        req->request.tx_len = 0;
+        req->request.tx_buf = req->tx_buf;
+        req->request.rx_len = 0;
+        req->request.rx_buf = NULL;
+        req->request.restart = 0;
+        req->request.callback = i2c_simple_callback;
+        req->dma_count = 0;
+        req->dma_next = 0;
+        req->dma_len = 0;
+        req->result = E_NO_ERROR;
+        req->notify = notify;
+        req->tag = tag;
+        req->state = I2C_REQ_PENDING;
+
+        pending_queue[(pending_head + pending_count) % I2C_REQ_POOL_SIZE] = i;
+        pending_count++;
+        return i;
+    }
+    return E_NONE_AVAIL;
+}
+
+/**
+ * @brief Completion callback for asynchronous HAL transactions
+ * 
+ * @param request: mxc_i2c_req_t*, request that finished
+ * @param result: int, HAL result of the transaction
+ *
+ * Runs in interrupt context. Records the result, releases the bus
+ * and posts the descriptor to the completion queue if requested
+*/
+static RAMFUNC void i2c_simple_callback(mxc_i2c_req_t* request, int result) {
+    i2c_simple_req_t* req = (i2c_simple_req_t*) request;
+
+    i2c_simple_account(req, result);
+    req->result = result;
+    req->state = I2C_REQ_DONE;
+    active_req = NULL;
+
+    if (req->notify) {
+        completion_queue[completion_tail % I2C_REQ_POOL_SIZE] = req - req_pool;
+        completion_tail++;
+    }
+}
+
+/**
+ * @brief Account a finished transfer against its address and speed
+ * 
+ * @param req: i2c_simple_req_t*, finished request
+ * @param result: int, HAL result of the transaction
+ *
+ * Probes are not counted since a NACK there only means nothing is present.
+ * When the errors in a window cross I2C_SPEED_ERR_THRESHOLD the address
+ * steps down one speed. A window without errors steps it back up one
+ * speed, at most to the advertised speed
+*/
+static void i2c_simple_account(i2c_simple_req_t* req, int result) {
+    if (req->request.tx_len == 0 && req->request.rx_len == 0) {
+        return;
+    }
+
+    i2c_speed_stats_t* stats = &speed_stats[req->request.addr & 0x7F];
+    stats->transfers[req->speed]++;
+    stats->window_transfers++;
+    if (result != E_NO_ERROR) {
+        stats->errors[req->speed]++;
+        stats->window_errors++;
+    }
+
+    if (stats->window_errors >= I2C_SPEED_ERR_THRESHOLD) {
+        if (stats->speed > I2C_SPEED_STANDARD) {
+            stats->speed--;
+            stats->max_speed = stats->speed;
+        }
+        stats->window_transfers = 0;
+        stats->window_errors = 0;
+    } else if (stats->window_transfers >= I2C_SPEED_WINDOW) {
+        if (stats->window_errors == 0 && stats->speed < stats->advertised) {
+            stats->speed++;
+            stats->max_speed = stats->speed;
+        }
+        stats->window_transfers = 0;
+        stats->window_errors = 0;
+    }
+}
+
+/**
+ * @brief Total length of a gathered payload
+ * 
+ * @param iov: const i2c_iovec_t*, segments of the payload
+ * @param count: unsigned int, number of segments
+ * 
+ * @return int: length of the payload, E_BAD_PARAM if it does not fit a message
+ *
+ * Checked before a descriptor is allocated, since an allocated
+ * descriptor is already queued for the bus
+*/
+static int i2c_simple_iov_len(const i2c_iovec_t* iov, unsigned int count) {
+    unsigned int len = 0;
+
+    if (count > I2C_IOV_MAX) {
+        return E_BAD_PARAM;
+    }
+    for (unsigned int i = 0; i < count; i++) {
+        len += iov[i].len;
+    }
+    if (len > UINT8_MAX) {
+        return E_BAD_PARAM;
+    }
+    return len;
+}
+
+/**
+ * @brief Attach a gathered write payload to a request
+ * 
+ * @param req: i2c_simple_req_t*, request with header_len bytes already in tx_buf
+ * @param header_len: unsigned int, number of header bytes in tx_buf
+ * @param iov: const i2c_iovec_t*, segments of the payload in order
+ * @param count: unsigned int, number of segments, checked by i2c_simple_iov_len
+ *
+ * Segments before the first one above I2C_DMA_THRESHOLD are copied behind
+ * the header and sent by the HAL. That segment and every one after it are
+ * sent in place by DMA, so at most I2C_IOV_MAX * I2C_DMA_THRESHOLD bytes
+ * are ever copied
+*/
+static void i2c_simple_set_payload(i2c_simple_req_t* req, unsigned int header_len,
+                                   const i2c_iovec_t* iov, unsigned int count) {
+    req->request.tx_len = header_len;
+    for (unsigned int i = 0; i < count; i++) {
+        if (iov[i].len == 0) {
+            continue;
+        }
+        if (req->dma_count == 0 && iov[i].len <= I2C_DMA_THRESHOLD) {
+            memcpy(&req->tx_buf[req->request.tx_len], iov[i].buf, iov[i].len);
+            req->request.tx_len += iov[i].len;
+            copy_stats.copies++;
+            copy_stats.bytes_copied += iov[i].len;
+        } else {
+            req->dma_iov[req->dma_count++] = iov[i];
+            req->dma_len += iov[i].len;
+            copy_stats.bytes_in_place += iov[i].len;
+        }
+    }
+}
+
+/**
+ * @brief Feed the next DMA segment of the active write
+ * 
+ * @param req: i2c_simple_req_t*, request with a DMA segment left
+ *
+ * The channel must already be configured for the I2C transmit FIFO.
+ * The controller stretches the clock if the FIFO runs dry in between
+*/
+static void i2c_simple_next_dma_segment(i2c_simple_req_t* req) {
+    const i2c_iovec_t* segment = &req->dma_iov[req->dma_next++];
+    mxc_dma_srcdst_t srcdst = {
+        .ch = tx_dma_ch,
+        .source = (void*) segment->buf,
+        .dest = NULL,
+        .len = segment->len,
+    };
+    MXC_DMA_SetSrcDst(srcdst);
+    MXC_DMA_Start(tx_dma_ch);
+}
+
+/**
+ * @brief Start a write whose payload is moved by DMA
+ * 
+ * @param req: i2c_simple_req_t*, request with a DMA payload
+ * 
+ * @return int: negative if error, 0 if the payload is streaming
+ *
+ * The address and header bytes go out through the FIFO, then the
+ * payload segments are fed from the caller's buffers by DMA. The transfer
+ * is finished by i2c_simple_poll_dma_write
+*/
+static int i2c_simple_start_dma_write(i2c_simple_req_t* req) {
+    MXC_I2C_ClearFlags(I2C_INTERFACE, 0xFFFFFFFF, 0xFFFFFFFF);
+    MXC_I2C_ClearTXFIFO(I2C_INTERFACE);
+
+    MXC_I2C_Start(I2C_INTERFACE);
+    if (MXC_I2C_WriteByte(I2C_INTERFACE, req->request.addr << 1) != E_NO_ERROR) {
+        MXC_I2C_Stop(I2C_INTERFACE);
+        return E_COMM_ERR;
+    }
+    for (unsigned int i = 0; i < req->request.tx_len; i++) {
+        if (MXC_I2C_WriteByte(I2C_INTERFACE, req->tx_buf[i]) != E_NO_ERROR) {
+            MXC_I2C_Stop(I2C_INTERFACE);
+            return E_COMM_ERR;
+        }
+    }
+
+    mxc_dma_config_t config = {
+        .ch = tx_dma_ch,
+        .reqsel = MXC_DMA_REQUEST_I2C1TX,
+        .srcwd = MXC_DMA_WIDTH_BYTE,
+        .dstwd = MXC_DMA_WIDTH_BYTE,
+        .srcinc_en = 1,
+        .dstinc_en = 0,
+    };
+    mxc_dma_srcdst_t srcdst = {
+        .ch = tx_dma_ch,
+        .source = (void*) req->dma_iov[0].buf,
+        .dest = NULL,
+        .len = req->dma_iov[0].len,
+    };
+    MXC_DMA_ConfigChannel(config, srcdst);
+    MXC_DMA_Start(tx_dma_ch);
+    req->dma_next = 1;
+    I2C_INTERFACE->dma |= MXC_F_I2C_DMA_TX_EN;
+
     return E_NO_ERROR;
 }
 
+/**
+ * @brief Advance the active DMA write
+ *
+ * Called from i2c_simple_service. Moves on to the next segment once the
+ * current one is in the FIFO. Sends STOP and completes the request when
+ * the last segment is out or as soon as the bus reports an error. The
+ * error flags are checked again once the STOP has completed
+*/
+static void i2c_simple_poll_dma_write(void) {
+    i2c_simple_req_t* req = active_req;
+    if (req == NULL || req->dma_len == 0) {
+        return;
+    }
+
+    int result = E_NO_ERROR;
+    if (I2C_INTERFACE->intfl0 & I2C_ERR_FLAGS) {
+        result = E_COMM_ERR;
+    } else if (MXC_DMA->ch[tx_dma_ch].cnt != 0) {
+        return;
+    } else if (req->dma_next < req->dma_count) {
+        i2c_simple_next_dma_segment(req);
+        return;
+    } else if (MXC_I2C_GetTXFIFOAvailable(I2C_INTERFACE) != 8) {
+        return;
+    }
+
+    MXC_DMA_Stop(tx_dma_ch);
+    I2C_INTERFACE->dma &= ~MXC_F_I2C_DMA_TX_EN;
+    MXC_I2C_Stop(I2C_INTERFACE);
+    // A NACK of the last payload byte or an error during STOP
+    // is only flagged once the STOP has gone out
+    if (I2C_INTERFACE->intfl0 & I2C_ERR_FLAGS) {
+        result = E_COMM_ERR;
+    }
+    MXC_I2C_ClearTXFIFO(I2C_INTERFACE);
+    i2c_simple_callback(&req->request, result);
+}
+
+/**
+ * @brief Set the negotiated bus speed for an address
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param speed: i2c_speed_t, fastest speed the device advertised
+ *
+ * Transfers to the address run at the lower of the advertised speed and
+ * I2C_MAX_SPEED. The error window for the address is reset. Interrupts
+ * are masked so a completion cannot account against a half-written entry
+*/
+void i2c_simple_set_max_speed(i2c_addr_t addr, i2c_speed_t speed) {
+    i2c_speed_stats_t* stats = &speed_stats[addr & 0x7F];
+
+    if (speed > I2C_MAX_SPEED) {
+        speed = I2C_MAX_SPEED;
+    }
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    stats->advertised = speed;
+    stats->max_speed = speed;
+    stats->speed = speed;
+    stats->window_transfers = 0;
+    stats->window_errors = 0;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Refresh the advertised bus speed for an address
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param speed: i2c_speed_t, fastest speed the device advertised
+ *
+ * Renegotiates only if the advertised speed changed. Otherwise a speed
+ * stepped down after errors is kept until an error-free window raises it
+*/
+void i2c_simple_refresh_max_speed(i2c_addr_t addr, i2c_speed_t speed) {
+    if (speed > I2C_MAX_SPEED) {
+        speed = I2C_MAX_SPEED;
+    }
+    if (speed != speed_stats[addr & 0x7F].advertised) {
+        i2c_simple_set_max_speed(addr, speed);
+    }
+}
+
+/**
+ * @brief Get the speed and error accounting for an address
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * 
+ * @return const i2c_speed_stats_t*: accounting for the address
+*/
+const i2c_speed_stats_t* i2c_simple_get_speed_stats(i2c_addr_t addr) {
+    return &speed_stats[addr & 0x7F];
+}
+
+/**
+ * @brief Bus frequency of a speed
+ * 
+ * @param speed: i2c_speed_t, bus speed
+ * 
+ * @return unsigned int: frequency in HZ
+*/
+unsigned int i2c_simple_speed_hz(i2c_speed_t speed) {
+    return speed_hz[speed];
+}
+
+/**
+ * @brief Get the payload copy accounting
+ * 
+ * @return const i2c_copy_stats_t*: copies made by every write so far
+*/
+const i2c_copy_stats_t* i2c_simple_get_copy_stats(void) {
+    return &copy_stats;
+}
+
+/**
+ * @brief Advance the asynchronous engine
+ * 
+ * Start the next pending request if the bus is idle. Called from the
+ * main loop, the completion calls and the synchronous wrappers
+*/
+RAMFUNC void i2c_simple_service(void) {
+    i2c_simple_poll_dma_write();
+
+    while (active_req == NULL && pending_count > 0) {
+        i2c_simple_req_t* req = &req_pool[pending_queue[pending_head]];
+        pending_head = (pending_head + 1) % I2C_REQ_POOL_SIZE;
+        pending_count--;
+
+        req->state = I2C_REQ_ACTIVE;
+        active_req = req;
+
+        // Clock the bus at the speed negotiated for this address
+        req->speed = speed_stats[req->request.addr & 0x7F].speed;
+        if (req->speed != bus_speed) {
+            MXC_I2C_SetFrequency(I2C_INTERFACE, speed_hz[req->speed]);
+            bus_speed = req->speed;
+        }
+
+        // Zero-length probes are only supported by the blocking HAL call,
+        // they are a single address byte so run them inline
+        if (req->request.tx_len == 0 && req->request.rx_len == 0) {
+            req->request.callback = NULL;
+            i2c_simple_callback(&req->request, MXC_I2C_MasterTransaction(&req->request));
+            continue;
+        }
+
+        // Large payloads are moved by DMA so the core is free while they transfer
+        int result;
+        if (req->dma_len > 0) {
+            result = i2c_simple_start_dma_write(req);
+        } else if (req->request.rx_len > I2C_DMA_THRESHOLD) {
+            result = MXC_I2C_MasterTransactionDMA(&req->request);
+        } else {
+            result = MXC_I2C_MasterTransactionAsync(&req->request);
+        }
+        if (result != E_NO_ERROR) {
+            // Transaction never started, complete it here with the error
+            i2c_simple_callback(&req->request, result);
+        }
+    }
+}
+
+/**
+ * @brief Wait for a request that is not posted to the completion queue
+ * 
+ * @param index: int, descriptor index returned from i2c_simple_alloc
+ * 
+ * @return int: result of the transaction
+ *
+ * Service the engine until the descriptor is done and return it to the pool
+*/
+static RAMFUNC int i2c_simple_wait(int index) {
+    i2c_simple_req_t* req = &req_pool[index];
+
+    while (req->state != I2C_REQ_DONE) {
+        i2c_simple_service();
+    }
+
+    int result = req->result;
+    req->state = I2C_REQ_FREE;
+    return result;
+}
+
+/**
+ * @brief Submit an asynchronous read of a register
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param reg: ECTF_I2C_REGS, register to read from
+ * @param len: uint8_t, length of data to read
+ * @param buf: uint8_t*, buffer to read data into, must stay valid until completion
+ * @param tag: uint32_t, caller value returned with the completion
+ * 
+ * @return int: descriptor index if queued, negative if error
+ *
+ * Queue a read on the asynchronous engine. The result is posted to the
+ * completion queue and must be collected with i2c_simple_complete
+*/
+int i2c_simple_submit_read(i2c_addr_t addr, ECTF_I2C_REGS reg, uint8_t len, uint8_t* buf, uint32_t tag) {
+    int index = i2c_simple_alloc(addr, tag, true);
+    if (index < 0) {
+        return index;
+    }
+
+    i2c_simple_req_t* req = &req_pool[index];
+    req->tx_buf[0] = reg;
+    req->request.tx_len = 1;
+    req->request.rx_len = len;
+    req->request.rx_buf = buf;
+
+    i2c_simple_service();
+    return index;
+}
+
+/**
+ * @brief Submit an asynchronous write of a register
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param reg: ECTF_I2C_REGS, register to write to
+ * @param len: uint8_t, length of data to write
+ * @param buf: uint8_t*, buffer to write data from, copied before returning
+ * @param tag: uint32_t, caller value returned with the completion
+ * 
+ * @return int: descriptor index if queued, negative if error
+ *
+ * Queue a write on the asynchronous engine. The result is posted to the
+ * completion queue and must be collected with i2c_simple_complete
+*/
+int i2c_simple_submit_write(i2c_addr_t addr, ECTF_I2C_REGS reg, uint8_t len, uint8_t* buf, uint32_t tag) {
+    int index = i2c_simple_alloc(addr, tag, true);
+    if (index < 0) {
+        return index;
+    }
+
+    i2c_simple_req_t* req = &req_pool[index];
+    req->tx_buf[0] = reg;
+    memcpy(&req->tx_buf[1], buf, len);
+    req->request.tx_len = len + 1;
+    copy_stats.copies++;
+    copy_stats.bytes_copied += len;
+
+    i2c_simple_service();
+    return index;
+}
+
+/**
+ * @brief Submit an asynchronous address probe
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param tag: uint32_t, caller value returned with the completion
+ * 
+ * @return int: descriptor index if queued, negative if error
+ *
+ * Queue a zero-length addressed write. The completion result is
+ * E_NO_ERROR if a device acknowledged the address
+*/
+int i2c_simple_submit_probe(i2c_addr_t addr, uint32_t tag) {
+    int index = i2c_simple_alloc(addr, tag, true);
+    if (index < 0) {
+        return index;
+    }
+
+    i2c_simple_service();
+    return index;
+}
+
+/**
+ * @brief Collect a finished asynchronous request
+ * 
+ * @param completion: i2c_simple_completion_t*, filled with the finished request
+ * 
+ * @return bool: true if a completion was returned, false if the queue is empty
+ *
+ * Drain one entry from the completion queue and return its descriptor to the pool
+*/
+RAMFUNC bool i2c_simple_complete(i2c_simple_completion_t* completion) {
+    i2c_simple_service();
+
+    if (completion_head == completion_tail) {
+        return false;
+    }
+
+    i2c_simple_req_t* req = &req_pool[completion_queue[completion_head % I2C_REQ_POOL_SIZE]];
+    completion_head++;
+
+    completion->tag = req->tag;
+    completion->addr = req->request.addr;
+    completion->result = req->result;
+    req->state = I2C_REQ_FREE;
+
+    // A slot was freed, keep the bus busy with the next request
+    i2c_simple_service();
+    return true;
+}
+
+/**
+ * @brief Check whether the asynchronous engine has outstanding work
+ * 
+ * @return bool: true if any request is pending, active or awaiting collection
+*/
+bool i2c_simple_busy(void) {
+    return active_req != NULL || pending_count > 0 || completion_head != completion_tail;
+}
+
+/**
+ * @brief Probe an address
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * 
+ * @return int: zero if the address was acknowledged, negative otherwise
+ *
+ * Issue a zero-length addressed write and report whether a device ACKed
+*/
+int i2c_simple_probe(i2c_addr_t addr) {
+    int index = i2c_simple_alloc(addr, 0, false);
+    if (index < 0) {
+        return index;
+    }
+    return i2c_simple_wait(index);
+}
+
 /**
  * @brief Read RECEIVE_DONE reg
  * 
@@ -165,6 +794,61 @@ int i2c_simple_write_transmit_len(i2c_addr_t addr, uint8_t len) {
     return i2c_simple_write_status_generic(addr, TRANSMIT_LEN, len); 
 }
 
+/**
+ * @brief Write RECEIVE_FRAME reg
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param ack: uint8_t, sequence of the last reply consumed
+ * @param seq: uint8_t, sequence of this request, echoed in its reply
+ * @param len: uint8_t, length of the payload
+ * @param buf: uint8_t*, payload to write
+ * 
+ * @return int: negative if error, 0 if success
+ *
+ * Deliver a complete message to an I2C peripheral in a single
+ * transaction. The peripheral queues the message on STOP
+*/
+int i2c_simple_write_receive_frame(i2c_addr_t addr, uint8_t ack, uint8_t seq, uint8_t len, uint8_t* buf) {
+    i2c_iovec_t iov = { buf, len };
+    return i2c_simple_write_receive_framev(addr, ack, seq, &iov, 1);
+}
+
+/**
+ * @brief Write RECEIVE_FRAME reg from separate segments
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param ack: uint8_t, sequence of the last reply consumed
+ * @param seq: uint8_t, sequence of this request, echoed in its reply
+ * @param iov: const i2c_iovec_t*, segments of the payload in order
+ * @param count: unsigned int, number of segments, at most I2C_IOV_MAX
+ * 
+ * @return int: negative if error, 0 if success
+ *
+ * As i2c_simple_write_receive_frame, the payload is gathered on the bus.
+ * Segments before the first one above I2C_DMA_THRESHOLD are copied behind
+ * the header, the rest are sent in place by DMA
+*/
+int i2c_simple_write_receive_framev(i2c_addr_t addr, uint8_t ack, uint8_t seq,
+                                    const i2c_iovec_t* iov, unsigned int count) {
+    int len = i2c_simple_iov_len(iov, count);
+    if (len < 0) {
+        return len;
+    }
+    int index = i2c_simple_alloc(addr, 0, false);
+    if (index < 0) {
+        return index;
+    }
+
+    i2c_simple_req_t* req = &req_pool[index];
+    req->tx_buf[0] = RECEIVE_FRAME;
+    req->tx_buf[1] = ack;
+    req->tx_buf[2] = seq;
+    req->tx_buf[3] = len;
+    i2c_simple_set_payload(req, 4, iov, count);
+
+    return i2c_simple_wait(index);
+}
+
 /**
  * @brief Read generic data reg
  * 
@@ -180,17 +864,18 @@ int i2c_simple_write_transmit_len(i2c_addr_t addr, uint8_t len) {
 */
 int i2c_simple_read_data_generic(i2c_addr_t addr, ECTF_I2C_REGS reg, uint8_t len, uint8_t* buf)
 {
-    mxc_i2c_req_t request;
-    request.i2c = I2C_INTERFACE;
-    request.addr = addr;
-    request.tx_len = 1;
-    request.tx_buf = (uint8_t*)&reg;
-    request.rx_len = (unsigned int) len;
-    request.rx_buf = buf;
-    request.restart = 0;
-    request.callback = NULL;
+    int index = i2c_simple_alloc(addr, 0, false);
+    if (index < 0) {
+        return index;
+    }
+
+    i2c_simple_req_t* req = &req_pool[index];
+    req->tx_buf[0] = reg;
+    req->request.tx_len = 1;
+    req->request.rx_len = (unsigned int) len;
+    req->request.rx_buf = buf;
 
-    return MXC_I2C_MasterTransaction(&request);
+    return i2c_simple_wait(index);
 }
 
 /**
@@ -207,21 +892,38 @@ int i2c_simple_read_data_generic(i2c_addr_t addr, ECTF_I2C_REGS reg, uint8_t len
  * Can be used to write the PARAMS or RESULT register
 */
 int i2c_simple_write_data_generic(i2c_addr_t addr, ECTF_I2C_REGS reg, uint8_t len, uint8_t* buf) {
-    uint8_t packet[257];
-    packet[0] = reg;
-    memcpy(&packet[1], buf, len);
-    
-    mxc_i2c_req_t request;
-    request.i2c = I2C_INTERFACE;
-    request.addr = addr;
-    request.tx_len = len+1;
-    request.tx_buf = packet;
-    request.rx_len = 0;
-    request.rx_buf = 0;
-    request.restart = 0;
-    request.callback = NULL;
+    i2c_iovec_t iov = { buf, len };
+    return i2c_simple_write_data_genericv(addr, reg, &iov, 1);
+}
 
-    return MXC_I2C_MasterTransaction(&request);
+/**
+ * @brief Write generic data reg from separate segments
+ * 
+ * @param addr: i2c_addr_t, address of I2C device
+ * @param reg: ECTF_I2C_REGS, register to write to
+ * @param iov: const i2c_iovec_t*, segments of the data in order
+ * @param count: unsigned int, number of segments, at most I2C_IOV_MAX
+ * 
+ * @return int: negative if error, 0 if success
+ * 
+ * As i2c_simple_write_data_generic, the data is gathered on the bus
+*/
+int i2c_simple_write_data_genericv(i2c_addr_t addr, ECTF_I2C_REGS reg,
+                                   const i2c_iovec_t* iov, unsigned int count) {
+    int len = i2c_simple_iov_len(iov, count);
+    if (len < 0) {
+        return len;
+    }
+    int index = i2c_simple_alloc(addr, 0, false);
+    if (index < 0) {
+        return index;
+    }
+
+    i2c_simple_req_t* req = &req_pool[index];
+    req->tx_buf[0] = reg;
+    i2c_simple_set_payload(req, 1, iov, count);
+
+    return i2c_simple_wait(index);
 }
 
 /**
@@ -237,17 +939,7 @@ int i2c_simple_write_data_generic(i2c_addr_t addr, ECTF_I2C_REGS reg, uint8_t le
 int i2c_simple_read_status_generic(i2c_addr_t addr, ECTF_I2C_REGS reg) {
     uint8_t value = 0;
 
-    mxc_i2c_req_t request;
-    request.i2c = I2C_INTERFACE;
-    request.addr = addr;
-    request.tx_len = 1;
-    request.tx_buf = (uint8_t*)&reg;
-    request.rx_len = 1;
-    request.rx_buf = (uint8_t*)&value;
-    request.restart = 0;
-    request.callback = NULL;
-
-    int result = MXC_I2C_MasterTransaction(&request);
+    int result = i2c_simple_read_data_generic(addr, reg, 1, &value);
     if (result < 0) {
         return result;
     }
@@ -266,19 +958,5 @@ int i2c_simple_read_status_generic(i2c_addr_t addr, ECTF_I2C_REGS reg) {
  * Write any register that is 1B in size
 */
 int i2c_simple_write_status_generic(i2c_addr_t addr, ECTF_I2C_REGS reg, uint8_t value) {
-    uint8_t packet[2];
-    packet[0] = (uint8_t) reg;
-    packet[1] = value;
-    
-    mxc_i2c_req_t request;
-    request.i2c = I2C_INTERFACE;
-    request.addr = addr;
-    request.tx_len = 2;
-    request.tx_buf = packet;
-    request.rx_len = 0;
-    request.rx_buf = 0;
-    request.restart = 0;
-    request.callback = NULL;
-
-    return MXC_I2C_MasterTransaction(&request);
+    return i2c_simple_write_data_generic(addr, reg, 1, &value);
 }
@@ -0,0 +1,90 @@
+/**
+ * @file "simple_timer.c"
+ * @brief Simple Free-Running Timer Implementation
+ * @date 2024
+ *
+ * This source file is part of an example system for MITRE's 2024 Embedded System CTF (eCTF).
+ * This code is being provided only for educational purposes for the 2024 MITRE eCTF competition,
+ * and may not meet MITRE standards for quality. Use this code at your own risk!
+ *
+ * @copyright Copyright (c) 2024 The MITRE Corporation
+ */
+
+#include "simple_timer.h"
+
+#include <stdbool.h>
+
+#include "mxc_device.h"
+#include "tmr.h"
+
+/******************************** FUNCTION DEFINITIONS ********************************/
+/**
+ * @brief Initialize the Simple Timer Interface
+ * 
+ * Start TIMER_INTERFACE as a free-running 32-bit counter clocked from the
+ * peripheral clock divided by TIMER_PRESCALE. At the default 50MHz
+ * peripheral clock a tick is 1.28us and the counter wraps after ~91 minutes.
+ * Also starts the core cycle counter
+*/
+void timer_simple_init(void) {
+    mxc_tmr_cfg_t cfg;
+
+    MXC_TMR_Shutdown(TIMER_INTERFACE);
+
+    cfg.pres = TMR_PRES_64;
+    cfg.mode = TMR_MODE_CONTINUOUS;
+    cfg.bitMode = TMR_BIT_MODE_32;
+    cfg.clock = MXC_TMR_APB_CLK;
+    cfg.cmp_cnt = 0xFFFFFFFF;
+    cfg.pol = 0;
+
+    MXC_TMR_Init(TIMER_INTERFACE, &cfg, false);
+    MXC_TMR_Start(TIMER_INTERFACE);
+
+    // Start the cycle counter
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * @brief Read the current tick count
+ * 
+ * @return uint32_t: current value of the free-running counter
+*/
+uint32_t timer_simple_ticks(void) {
+    return MXC_TMR_GetCount(TIMER_INTERFACE);
+}
+
+/**
+ * @brief Convert a tick count to microseconds
+ * 
+ * @param ticks: uint32_t, number of ticks
+ * 
+ * @return uint32_t: duration in microseconds
+*/
+uint32_t timer_simple_ticks_to_us(uint32_t ticks) {
+    // The APB peripheral clock runs at half the system clock
+    uint32_t ticks_per_sec = (SystemCoreClock / 2) / TIMER_PRESCALE;
+    return (uint32_t) (((uint64_t) ticks * 1000000) / ticks_per_sec);
+}
+
+/**
+ * @brief Microseconds elapsed since a previous tick count
+ * 
+ * @param since: uint32_t, tick count returned from timer_simple_ticks
+ * 
+ * @return uint32_t: microseconds between since and now
+*/
+uint32_t timer_simple_elapsed_us(uint32_t since) {
+    return timer_simple_ticks_to_us(timer_simple_ticks() - since);
+}
+
+/**
+ * @brief Read the core cycle counter
+ * 
+ * @return uint32_t: current value of the DWT cycle counter
+*/
+uint32_t timer_simple_cycles(void) {
+    return DWT->CYCCNT;
+}
@@ -0,0 +1,30 @@
+/**
+ * @file "crypto_zero.h"
+ * @brief Key Material Clearing Header
+ * @date 2024
+ *
+ * This source file is part of an example system for MITRE's 2024 Embedded System CTF (eCTF).
+ * This code is being provided only for educational purposes for the 2024 MITRE eCTF competition,
+ * and may not meet MITRE standards for quality. Use this code at your own risk!
+ *
+ * @copyright Copyright (c) 2024 The MITRE Corporation
+ */
+
+#ifndef __CRYPTO_ZERO__
+#define __CRYPTO_ZERO__
+
+#include <stddef.h>
+
+/******************************** FUNCTION PROTOTYPES ********************************/
+/**
+ * @brief Clear memory holding key material
+ * 
+ * @param buf: void*, buffer to clear
+ * @param len: size_t, length of buf
+ * 
+ * Goes through a volatile pointer so the stores are not optimized away,
+ * even when buf goes out of scope right after
+*/
+void crypto_zero(void* buf, size_t len);
+
+#endif
@@ -0,0 +1,22 @@
+/**
+ * @file "i2c_frame.h"
+ * @brief I2C Frame Layout Header
+ * @date 2024
+ *
+ * This source file is part of an example system for MITRE's 2024 Embedded System CTF (eCTF).
+ * This code is being provided only for educational purposes for the 2024 MITRE eCTF competition,
+ * and may not meet MITRE standards for quality. Use this code at your own risk!
+ *
+ * @copyright Copyright (c) 2024 The MITRE Corporation
+ */
+
+#ifndef __I2C_FRAME__
+#define __I2C_FRAME__
+
+/******************************** MACRO DEFINITIONS ********************************/
+// Payload bytes a TRANSMIT_FRAME read returns after the done flag, the
+// sequence and the length. The AP prefetches this many and a component
+// mirrors this many bytes of a constant reply, so both must agree
+#define I2C_FRAME_INLINE_LEN 8
+
+#endif
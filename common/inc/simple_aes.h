@@ -0,0 +1,81 @@
+/**
+ * @file "simple_aes.h"
+ * @brief Simple AES Engine Header
+ * @date 2024
+ *
+ * This source file is part of an example system for MITRE's 2024 Embedded System CTF (eCTF).
+ * This code is being provided only for educational purposes for the 2024 MITRE eCTF competition,
+ * and may not meet MITRE standards for quality. Use this code at your own risk!
+ *
+ * @copyright Copyright (c) 2024 The MITRE Corporation
+ */
+
+#ifndef __SIMPLE_AES__
+#define __SIMPLE_AES__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aes.h"
+
+/******************************** MACRO DEFINITIONS ********************************/
+#define AES_SIMPLE_BLOCK 16
+#define AES_SIMPLE_KEY_SIZE 16
+// Blocks handed to the engine per request
+#define AES_SIMPLE_CHUNK 16
+
+/******************************** FUNCTION PROTOTYPES ********************************/
+/**
+ * @brief Initialize the AES engine
+ * 
+ * @return int: negative if error, zero if successful
+ * 
+ * Safe to call more than once, only the first call touches the engine
+*/
+int aes_simple_init(void);
+
+/**
+ * @brief Run blocks through the AES engine with an external key
+ * 
+ * @param key: const uint8_t*, AES_SIMPLE_KEY_SIZE byte key
+ * @param type: mxc_aes_enc_type_t, MXC_AES_ENCRYPT_EXT_KEY or MXC_AES_DECRYPT_EXT_KEY
+ * @param in: const uint8_t*, blocks to transform
+ * @param len: size_t, length of in, a multiple of AES_SIMPLE_BLOCK
+ * @param out: uint8_t*, buffer for the result, may equal in
+ * 
+ * @return int: negative if error, zero if successful
+ * 
+ * The engine only takes word aligned buffers, so data is staged
+ * AES_SIMPLE_CHUNK blocks at a time
+*/
+int aes_simple_ecb(const uint8_t* key, mxc_aes_enc_type_t type, const uint8_t* in,
+                   size_t len, uint8_t* out);
+
+/**
+ * @brief Increment a big-endian counter block
+ * 
+ * @param counter: uint8_t*, AES_SIMPLE_BLOCK byte counter block
+ * @param width: int, number of trailing bytes that form the counter
+*/
+void aes_simple_ctr_increment(uint8_t* counter, int width);
+
+/**
+ * @brief XOR a counter mode keystream into data
+ * 
+ * @param key: const uint8_t*, AES_SIMPLE_KEY_SIZE byte key
+ * @param counter: uint8_t*, AES_SIMPLE_BLOCK byte initial counter block,
+ *   left at the next unused block
+ * @param width: int, number of trailing counter bytes that are incremented
+ * @param in: const uint8_t*, data to transform
+ * @param len: size_t, length of data, any length
+ * @param out: uint8_t*, buffer for the result, may equal in
+ * 
+ * @return int: negative if error, zero if successful
+ * 
+ * Builds AES_SIMPLE_CHUNK counter blocks at a time and encrypts them
+ * in one engine request
+*/
+int aes_simple_ctr(const uint8_t* key, uint8_t* counter, int width, const uint8_t* in,
+                   size_t len, uint8_t* out);
+
+#endif
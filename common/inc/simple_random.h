@@ -0,0 +1,75 @@
+/**
+ * @file "simple_random.h"
+ * @brief Simple Random Byte Pool Header
+ * @date 2024
+ *
+ * This source file is part of an example system for MITRE's 2024 Embedded System CTF (eCTF).
+ * This code is being provided only for educational purposes for the 2024 MITRE eCTF competition,
+ * and may not meet MITRE standards for quality. Use this code at your own risk!
+ *
+ * @copyright Copyright (c) 2024 The MITRE Corporation
+ */
+
+#ifndef __SIMPLE_RANDOM__
+#define __SIMPLE_RANDOM__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/******************************** MACRO DEFINITIONS ********************************/
+// Random bytes kept ready for random_simple_get
+#define RANDOM_POOL_SIZE 256
+// TRNG bytes collected per reseed, the first half is mixed into the
+// DRBG key and the second half into its counter
+#define RANDOM_SEED_SIZE 32
+// DRBG output between reseeds from the TRNG
+#define RANDOM_RESEED_INTERVAL 4096
+
+/******************************** TYPE DEFINITIONS ********************************/
+// Pool accounting returned by random_simple_stats
+typedef struct {
+    uint32_t fill;
+    uint32_t served;
+    uint32_t stalls;
+    uint32_t reseeds;
+} random_stats_t;
+
+/******************************** FUNCTION PROTOTYPES ********************************/
+/**
+ * @brief Initialize the Random Byte Pool
+ * 
+ * @return int: negative if error, zero if successful
+ * 
+ * Seed the DRBG from the TRNG, blocking once, and fill the pool.
+ * Later seeds are collected by the TRNG interrupt
+*/
+int random_simple_init(void);
+
+/**
+ * @brief Refill the pool
+ * 
+ * Called when idle. Tops the pool up from the DRBG, mixes in a
+ * finished TRNG seed and starts collecting the next one when due
+*/
+void random_simple_service(void);
+
+/**
+ * @brief Take random bytes from the pool
+ * 
+ * @param buf: uint8_t*, buffer to fill
+ * @param len: size_t, number of bytes wanted
+ * 
+ * @return int: zero if buf was filled, negative if the pool holds fewer than len bytes
+ * 
+ * Never blocks. A short pool is counted as a stall and leaves buf untouched
+*/
+int random_simple_get(uint8_t* buf, size_t len);
+
+/**
+ * @brief Get the pool accounting
+ * 
+ * @return const random_stats_t*: current fill level and counters
+*/
+const random_stats_t* random_simple_stats(void);
+
+#endif
@@ -0,0 +1,185 @@
+/**
+ * @file "simple_session.h"
+ * @brief Simple Session Layer Header
+ * @date 2024
+ *
+ * This source file is part of an example system for MITRE's 2024 Embedded System CTF (eCTF).
+ * This code is being provided only for educational purposes for the 2024 MITRE eCTF competition,
+ * and may not meet MITRE standards for quality. Use this code at your own risk!
+ *
+ * @copyright Copyright (c) 2024 The MITRE Corporation
+ */
+
+#ifndef __SIMPLE_SESSION__
+#define __SIMPLE_SESSION__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/******************************** MACRO DEFINITIONS ********************************/
+// Message types of the session layer, clear of the component command opcodes
+// HELLO carries the AP nonce, the reply the component nonce and its proof
+// RESUME carries the session ID and a fresh AP nonce, the reply as for HELLO
+// RECORD carries the sequence number, the ciphertext and the tag
+#define SESSION_MSG_HELLO 0x40
+#define SESSION_MSG_RESUME 0x41
+#define SESSION_MSG_RECORD 0x42
+
+#define SESSION_KEY_SIZE 16
+#define SESSION_NONCE_SIZE 16
+#define SESSION_TAG_SIZE 16
+#define SESSION_SEQ_SIZE 4
+// A session is named by the nonces of the handshake that created it
+#define SESSION_ID_SIZE (2 * SESSION_NONCE_SIZE)
+
+// Largest record that fits a board link packet, and the payload it carries
+#define SESSION_RECORD_MAX 255
+// A record is the message type and sequence number, the ciphertext and the tag
+#define SESSION_HEADER_SIZE (1 + SESSION_SEQ_SIZE)
+#define SESSION_OVERHEAD (SESSION_HEADER_SIZE + SESSION_TAG_SIZE)
+#define SESSION_MAX_PAYLOAD (SESSION_RECORD_MAX - SESSION_OVERHEAD)
+
+/******************************** TYPE DEFINITIONS ********************************/
+// Side of the link, records are keyed per direction
+typedef enum {
+    SESSION_ROLE_AP,
+    SESSION_ROLE_COMPONENT,
+} session_role_t;
+
+// Keys and sequence numbers of one secure channel
+// master survives a resumption, the traffic keys and proof are replaced
+typedef struct {
+    bool open;
+    uint8_t role;
+    uint8_t id[SESSION_ID_SIZE];
+    uint8_t master[SESSION_KEY_SIZE];
+    uint8_t enc_key[SESSION_KEY_SIZE];
+    uint8_t mac_key[SESSION_KEY_SIZE];
+    uint8_t proof[SESSION_TAG_SIZE];
+    uint32_t send_seq;
+    uint32_t recv_seq;
+} session_t;
+
+/******************************** FUNCTION PROTOTYPES ********************************/
+/**
+ * @brief Take a handshake nonce from the random pool
+ *
+ * @param nonce: uint8_t*, SESSION_NONCE_SIZE bytes to fill
+ *
+ * @return int: negative if error, zero if successful
+ *
+ * Refills the pool once if it runs short
+*/
+int session_simple_nonce(uint8_t* nonce);
+
+/**
+ * @brief Start a new session
+ *
+ * @param session: session_t*, session to initialize
+ * @param role: session_role_t, side of the link
+ * @param root: const uint8_t*, SESSION_KEY_SIZE byte deployment key
+ * @param nonce_ap: const uint8_t*, nonce sent by the AP
+ * @param nonce_comp: const uint8_t*, nonce sent by the component
+ *
+ * @return int: negative if error, zero if successful
+ *
+ * Derives the master key from the root key and both nonces, then the
+ * traffic keys and the proof, and opens the session with both
+ * sequence numbers at zero
+*/
+int session_simple_start(session_t* session, session_role_t role, const uint8_t* root,
+                         const uint8_t* nonce_ap, const uint8_t* nonce_comp);
+
+/**
+ * @brief Rebuild the master key of a session from its ID
+ *
+ * @param session: session_t*, session to initialize
+ * @param role: session_role_t, side of the link
+ * @param root: const uint8_t*, SESSION_KEY_SIZE byte deployment key
+ * @param id: const uint8_t*, SESSION_ID_SIZE byte session ID
+ *
+ * @return int: negative if error, zero if successful
+ *
+ * Lets a component that lost its state accept a resumption. The session
+ * stays closed until session_simple_resume
+*/
+int session_simple_restore(session_t* session, session_role_t role, const uint8_t* root,
+                           const uint8_t* id);
+
+/**
+ * @brief Resume a session with fresh traffic keys
+ *
+ * @param session: session_t*, session holding the master key
+ * @param nonce_ap: const uint8_t*, nonce sent by the AP
+ * @param nonce_comp: const uint8_t*, nonce sent by the component
+ *
+ * @return int: negative if error, zero if successful
+ *
+ * Keeps the ID and master key, derives new traffic keys and proof from
+ * the nonces and restarts both sequence numbers at zero
+*/
+int session_simple_resume(session_t* session, const uint8_t* nonce_ap,
+                          const uint8_t* nonce_comp);
+
+/**
+ * @brief Check the proof sent by the peer
+ *
+ * @param session: const session_t*, session being established
+ * @param proof: const uint8_t*, SESSION_TAG_SIZE bytes received
+ *
+ * @return bool: true if the peer derived the same keys
+*/
+bool session_simple_verify(const session_t* session, const uint8_t* proof);
+
+/**
+ * @brief Encrypt and authenticate a message
+ *
+ * @param session: session_t*, open session
+ * @param in: const uint8_t*, plaintext
+ * @param len: uint8_t, length of the plaintext, at most SESSION_MAX_PAYLOAD
+ * @param out: uint8_t*, buffer for the record, len + SESSION_OVERHEAD bytes
+ *
+ * @return int: length of the record, negative if error
+*/
+int session_simple_seal(session_t* session, const uint8_t* in, uint8_t len, uint8_t* out);
+
+/**
+ * @brief Encrypt and authenticate a message into separate record parts
+ *
+ * @param session: session_t*, open session
+ * @param in: const uint8_t*, plaintext
+ * @param len: uint8_t, length of the plaintext, at most SESSION_MAX_PAYLOAD
+ * @param header: uint8_t*, SESSION_HEADER_SIZE bytes for the record header
+ * @param ct: uint8_t*, len bytes for the ciphertext
+ * @param tag: uint8_t*, SESSION_TAG_SIZE bytes for the tag
+ *
+ * @return int: length of the record, negative if error
+ *
+ * For gathered writes, the parts are sent back to back as one record
+*/
+int session_simple_sealv(session_t* session, const uint8_t* in, uint8_t len,
+                         uint8_t* header, uint8_t* ct, uint8_t* tag);
+
+/**
+ * @brief Authenticate and decrypt a record
+ *
+ * @param session: session_t*, open session
+ * @param in: const uint8_t*, record received
+ * @param len: int, length of the record
+ * @param out: uint8_t*, buffer for the plaintext
+ *
+ * @return int: length of the plaintext, negative if error
+ *
+ * Records must arrive in sequence. A record that is out of order or
+ * fails authentication is dropped and out is left untouched
+*/
+int session_simple_open(session_t* session, const uint8_t* in, int len, uint8_t* out);
+
+/**
+ * @brief Close a session and clear its keys
+ *
+ * @param session: session_t*, session to close
+*/
+void session_simple_close(session_t* session);
+
+#endif
@@ -0,0 +1,32 @@
+/**
+ * @file "crypto_zero.c"
+ * @brief Key Material Clearing Implementation
+ * @date 2024
+ *
+ * This source file is part of an example system for MITRE's 2024 Embedded System CTF (eCTF).
+ * This code is being provided only for educational purposes for the 2024 MITRE eCTF competition,
+ * and may not meet MITRE standards for quality. Use this code at your own risk!
+ *
+ * @copyright Copyright (c) 2024 The MITRE Corporation
+ */
+
+#include "crypto_zero.h"
+
+#include <stdint.h>
+
+/******************************** FUNCTION DEFINITIONS ********************************/
+/**
+ * @brief Clear memory holding key material
+ * 
+ * @param buf: void*, buffer to clear
+ * @param len: size_t, length of buf
+ * 
+ * Goes through a volatile pointer so the stores are not optimized away,
+ * even when buf goes out of scope right after
+*/
+void crypto_zero(void* buf, size_t len) {
+    volatile uint8_t* p = (volatile uint8_t*)buf;
+    for (size_t i = 0; i < len; i++) {
+        p[i] = 0;
+    }
+}
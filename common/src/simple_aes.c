@@ -0,0 +1,151 @@
+/**
+ * @file "simple_aes.c"
+ * @brief Simple AES Engine Implementation
+ * @date 2024
+ *
+ * This source file is part of an example system for MITRE's 2024 Embedded System CTF (eCTF).
+ * This code is being provided only for educational purposes for the 2024 MITRE eCTF competition,
+ * and may not meet MITRE standards for quality. Use this code at your own risk!
+ *
+ * @copyright Copyright (c) 2024 The MITRE Corporation
+ */
+
+#include "simple_aes.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "crypto_zero.h"
+#include "mxc_errors.h"
+
+/******************************** GLOBAL DEFINITIONS ********************************/
+// Set once the engine has been initialized
+static bool aes_ready = false;
+
+/******************************** FUNCTION DEFINITIONS ********************************/
+/**
+ * @brief Initialize the AES engine
+ * 
+ * @return int: negative if error, zero if successful
+ * 
+ * Safe to call more than once, only the first call touches the engine
+*/
+int aes_simple_init(void) {
+    if (aes_ready) {
+        return E_NO_ERROR;
+    }
+    int error = MXC_AES_Init();
+    if (error == E_NO_ERROR) {
+        aes_ready = true;
+    }
+    return error;
+}
+
+/**
+ * @brief Run blocks through the AES engine with an external key
+ * 
+ * @param key: const uint8_t*, AES_SIMPLE_KEY_SIZE byte key
+ * @param type: mxc_aes_enc_type_t, MXC_AES_ENCRYPT_EXT_KEY or MXC_AES_DECRYPT_EXT_KEY
+ * @param in: const uint8_t*, blocks to transform
+ * @param len: size_t, length of in, a multiple of AES_SIMPLE_BLOCK
+ * @param out: uint8_t*, buffer for the result, may equal in
+ * 
+ * @return int: negative if error, zero if successful
+ * 
+ * The engine only takes word aligned buffers, so data is staged
+ * AES_SIMPLE_CHUNK blocks at a time
+*/
+int aes_simple_ecb(const uint8_t* key, mxc_aes_enc_type_t type, const uint8_t* in,
+                   size_t len, uint8_t* out) {
+    uint32_t key_words[AES_SIMPLE_KEY_SIZE / sizeof(uint32_t)];
+    uint32_t words_in[AES_SIMPLE_CHUNK * AES_SIMPLE_BLOCK / sizeof(uint32_t)];
+    uint32_t words_out[AES_SIMPLE_CHUNK * AES_SIMPLE_BLOCK / sizeof(uint32_t)];
+    int error = E_NO_ERROR;
+
+    memcpy(key_words, key, AES_SIMPLE_KEY_SIZE);
+    MXC_AES_SetExtKey(key_words, MXC_AES_128BITS);
+    while (len > 0 && error == E_NO_ERROR) {
+        size_t count = len < sizeof(words_in) ? len : sizeof(words_in);
+        mxc_aes_req_t req = {
+            .length = count / sizeof(uint32_t),
+            .inputData = words_in,
+            .resultData = words_out,
+            .keySize = MXC_AES_128BITS,
+            .encryption = type,
+        };
+
+        memcpy(words_in, in, count);
+        if (type == MXC_AES_ENCRYPT_EXT_KEY) {
+            error = MXC_AES_Encrypt(&req);
+        } else {
+            error = MXC_AES_Decrypt(&req);
+        }
+        memcpy(out, words_out, count);
+
+        in += count;
+        out += count;
+        len -= count;
+    }
+
+    crypto_zero(key_words, sizeof(key_words));
+    crypto_zero(words_in, sizeof(words_in));
+    crypto_zero(words_out, sizeof(words_out));
+    return error;
+}
+
+/**
+ * @brief Increment a big-endian counter block
+ * 
+ * @param counter: uint8_t*, AES_SIMPLE_BLOCK byte counter block
+ * @param width: int, number of trailing bytes that form the counter
+*/
+void aes_simple_ctr_increment(uint8_t* counter, int width) {
+    for (int i = AES_SIMPLE_BLOCK - 1; i >= AES_SIMPLE_BLOCK - width; i--) {
+        if (++counter[i] != 0) {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief XOR a counter mode keystream into data
+ * 
+ * @param key: const uint8_t*, AES_SIMPLE_KEY_SIZE byte key
+ * @param counter: uint8_t*, AES_SIMPLE_BLOCK byte initial counter block,
+ *   left at the next unused block
+ * @param width: int, number of trailing counter bytes that are incremented
+ * @param in: const uint8_t*, data to transform
+ * @param len: size_t, length of data, any length
+ * @param out: uint8_t*, buffer for the result, may equal in
+ * 
+ * @return int: negative if error, zero if successful
+ * 
+ * Builds AES_SIMPLE_CHUNK counter blocks at a time and encrypts them
+ * in one engine request
+*/
+int aes_simple_ctr(const uint8_t* key, uint8_t* counter, int width, const uint8_t* in,
+                   size_t len, uint8_t* out) {
+    uint8_t stream[AES_SIMPLE_CHUNK * AES_SIMPLE_BLOCK];
+    int error = E_NO_ERROR;
+
+    while (len > 0 && error == E_NO_ERROR) {
+        size_t count = len < sizeof(stream) ? len : sizeof(stream);
+        size_t stream_len = (count + AES_SIMPLE_BLOCK - 1) & ~(size_t)(AES_SIMPLE_BLOCK - 1);
+
+        for (size_t i = 0; i < stream_len; i += AES_SIMPLE_BLOCK) {
+            memcpy(&stream[i], counter, AES_SIMPLE_BLOCK);
+            aes_simple_ctr_increment(counter, width);
+        }
+        error = aes_simple_ecb(key, MXC_AES_ENCRYPT_EXT_KEY, stream, stream_len, stream);
+        for (size_t i = 0; i < count; i++) {
+            out[i] = in[i] ^ stream[i];
+        }
+
+        in += count;
+        out += count;
+        len -= count;
+    }
+
+    crypto_zero(stream, sizeof(stream));
+    return error;
+}
@@ -0,0 +1,238 @@
+/**
+ * @file "simple_random.c"
+ * @brief Simple Random Byte Pool Implementation
+ * @date 2024
+ *
+ * This source file is part of an example system for MITRE's 2024 Embedded System CTF (eCTF).
+ * This code is being provided only for educational purposes for the 2024 MITRE eCTF competition,
+ * and may not meet MITRE standards for quality. Use this code at your own risk!
+ *
+ * @copyright Copyright (c) 2024 The MITRE Corporation
+ */
+
+#include "simple_random.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "crypto_zero.h"
+#include "mxc_device.h"
+#include "mxc_errors.h"
+#include "nvic_table.h"
+#include "simple_aes.h"
+#include "trng.h"
+
+/******************************** GLOBAL DEFINITIONS ********************************/
+// AES block size of the DRBG and blocks generated per engine request
+#define DRBG_BLOCK AES_SIMPLE_BLOCK
+#define DRBG_CHUNK 8
+
+// DRBG state, an AES-128 key and the counter block it encrypts
+static uint8_t drbg_key[AES_SIMPLE_KEY_SIZE];
+static uint8_t drbg_v[DRBG_BLOCK];
+static uint32_t drbg_output = 0;
+
+// Pool of generated bytes, only touched from main
+static uint8_t pool[RANDOM_POOL_SIZE];
+static uint32_t pool_tail = 0;
+static random_stats_t stats;
+
+// Seed collected by the TRNG interrupt
+static uint8_t seed[RANDOM_SEED_SIZE];
+static volatile bool seed_pending = false;
+static volatile bool seed_ready = false;
+
+/******************************** FUNCTION DEFINITIONS ********************************/
+/**
+ * @brief Completion callback for the asynchronous TRNG read
+ * 
+ * @param req: void*, unused
+ * @param result: int, result of the read
+*/
+static void random_simple_seed_done(void* req, int result) {
+    seed_ready = (result == E_NO_ERROR);
+    seed_pending = false;
+}
+
+/**
+ * @brief Generate DRBG output
+ * 
+ * @param out: uint8_t*, buffer for the output
+ * @param blocks: unsigned int, number of blocks to generate, at most DRBG_CHUNK
+ * 
+ * @return int: negative if error, zero if successful
+ * 
+ * Encrypts the next counter values with the DRBG key in one engine request
+*/
+static int random_simple_drbg_blocks(uint8_t* out, unsigned int blocks) {
+    uint8_t counters[DRBG_CHUNK * DRBG_BLOCK];
+
+    for (unsigned int i = 0; i < blocks; i++) {
+        aes_simple_ctr_increment(drbg_v, DRBG_BLOCK);
+        memcpy(&counters[i * DRBG_BLOCK], drbg_v, DRBG_BLOCK);
+    }
+    return aes_simple_ecb(drbg_key, MXC_AES_ENCRYPT_EXT_KEY, counters,
+                          blocks * DRBG_BLOCK, out);
+}
+
+/**
+ * @brief Replace the DRBG key and counter
+ * 
+ * @param data: const uint8_t*, RANDOM_SEED_SIZE bytes to mix in, NULL for none
+ * 
+ * @return int: negative if error, zero if successful
+ * 
+ * Run after every refill so earlier output cannot be recovered from the
+ * state, and with TRNG data to reseed. The key and counter are left as
+ * they were if the engine fails
+*/
+static int random_simple_drbg_update(const uint8_t* data) {
+    uint8_t next[2 * DRBG_BLOCK];
+
+    int error = random_simple_drbg_blocks(next, 2);
+    if (error == E_NO_ERROR) {
+        if (data != NULL) {
+            for (int i = 0; i < RANDOM_SEED_SIZE; i++) {
+                next[i] ^= data[i];
+            }
+        }
+        memcpy(drbg_key, next, DRBG_BLOCK);
+        memcpy(drbg_v, &next[DRBG_BLOCK], DRBG_BLOCK);
+    }
+    crypto_zero(next, sizeof(next));
+    return error;
+}
+
+/**
+ * @brief Top the pool up from the DRBG
+ * 
+ * @return int: negative if error, zero if successful
+*/
+static int random_simple_refill(void) {
+    uint8_t blocks[DRBG_CHUNK * DRBG_BLOCK];
+    bool generated = false;
+    int error = E_NO_ERROR;
+
+    while (RANDOM_POOL_SIZE - stats.fill >= DRBG_BLOCK) {
+        unsigned int count = (RANDOM_POOL_SIZE - stats.fill) / DRBG_BLOCK;
+        if (count > DRBG_CHUNK) {
+            count = DRBG_CHUNK;
+        }
+        error = random_simple_drbg_blocks(blocks, count);
+        if (error != E_NO_ERROR) {
+            break;
+        }
+        generated = true;
+
+        // Append behind the bytes still in the pool
+        for (unsigned int i = 0; i < count * DRBG_BLOCK; i++) {
+            pool[(pool_tail + stats.fill) % RANDOM_POOL_SIZE] = blocks[i];
+            stats.fill++;
+        }
+        drbg_output += count * DRBG_BLOCK;
+    }
+
+    if (generated) {
+        int update = random_simple_drbg_update(NULL);
+        if (error == E_NO_ERROR) {
+            error = update;
+        }
+    }
+    crypto_zero(blocks, sizeof(blocks));
+    return error;
+}
+
+/**
+ * @brief Initialize the Random Byte Pool
+ * 
+ * @return int: negative if error, zero if successful
+ * 
+ * Seed the DRBG from the TRNG, blocking once, and fill the pool.
+ * Later seeds are collected by the TRNG interrupt
+*/
+int random_simple_init(void) {
+    int error;
+
+    error = MXC_TRNG_Init();
+    if (error != E_NO_ERROR) {
+        return error;
+    }
+    error = aes_simple_init();
+    if (error != E_NO_ERROR) {
+        return error;
+    }
+    MXC_NVIC_SetVector(TRNG_IRQn, MXC_TRNG_Handler);
+    NVIC_EnableIRQ(TRNG_IRQn);
+
+    // First seed is read synchronously, nothing can run without it
+    error = MXC_TRNG_Random(seed, RANDOM_SEED_SIZE);
+    if (error != E_NO_ERROR) {
+        return error;
+    }
+    error = random_simple_drbg_update(seed);
+    crypto_zero(seed, sizeof(seed));
+    if (error != E_NO_ERROR) {
+        return error;
+    }
+    stats.reseeds++;
+
+    return random_simple_refill();
+}
+
+/**
+ * @brief Refill the pool
+ * 
+ * Called when idle. Tops the pool up from the DRBG, mixes in a
+ * finished TRNG seed and starts collecting the next one when due
+*/
+void random_simple_service(void) {
+    if (seed_ready) {
+        seed_ready = false;
+        if (random_simple_drbg_update(seed) == E_NO_ERROR) {
+            drbg_output = 0;
+            stats.reseeds++;
+        }
+        crypto_zero(seed, sizeof(seed));
+    } else if (!seed_pending && drbg_output >= RANDOM_RESEED_INTERVAL) {
+        seed_pending = true;
+        MXC_TRNG_RandomAsync(seed, RANDOM_SEED_SIZE, random_simple_seed_done);
+    }
+
+    random_simple_refill();
+}
+
+/**
+ * @brief Take random bytes from the pool
+ * 
+ * @param buf: uint8_t*, buffer to fill
+ * @param len: size_t, number of bytes wanted
+ * 
+ * @return int: zero if buf was filled, negative if the pool holds fewer than len bytes
+ * 
+ * Never blocks. A short pool is counted as a stall and leaves buf untouched
+*/
+int random_simple_get(uint8_t* buf, size_t len) {
+    if (len > stats.fill) {
+        stats.stalls++;
+        return E_NONE_AVAIL;
+    }
+
+    // Hand out each byte once and clear it from the pool
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = pool[pool_tail];
+        pool[pool_tail] = 0;
+        pool_tail = (pool_tail + 1) % RANDOM_POOL_SIZE;
+    }
+    stats.fill -= len;
+    stats.served += len;
+    return E_NO_ERROR;
+}
+
+/**
+ * @brief Get the pool accounting
+ * 
+ * @return const random_stats_t*: current fill level and counters
+*/
+const random_stats_t* random_simple_stats(void) {
+    return &stats;
+}
@@ -0,0 +1,412 @@
+/**
+ * @file "simple_session.c"
+ * @brief Simple Session Layer Implementation
+ * @date 2024
+ *
+ * This source file is part of an example system for MITRE's 2024 Embedded System CTF (eCTF).
+ * This code is being provided only for educational purposes for the 2024 MITRE eCTF competition,
+ * and may not meet MITRE standards for quality. Use this code at your own risk!
+ *
+ * @copyright Copyright (c) 2024 The MITRE Corporation
+ */
+
+#include "simple_session.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "crypto_zero.h"
+#include "mxc_errors.h"
+#include "simple_aes.h"
+#include "simple_random.h"
+
+/******************************** GLOBAL DEFINITIONS ********************************/
+// AES block size, the engine is brought up by random_simple_init
+#define SESSION_BLOCK AES_SIMPLE_BLOCK
+
+// First byte of every block a key is used on first, keeps the key
+// derivations, the proof and the record tags apart
+#define SESSION_LABEL_MASTER 'S'
+#define SESSION_LABEL_ENC 'E'
+#define SESSION_LABEL_MAC 'M'
+#define SESSION_LABEL_PROOF 'P'
+#define SESSION_LABEL_RECORD 'R'
+
+/******************************** FUNCTION DEFINITIONS ********************************/
+/**
+ * @brief CBC-MAC over a leading block and zero padded data
+ *
+ * @param key: const uint8_t*, SESSION_KEY_SIZE byte key
+ * @param first: const uint8_t*, leading block, fixes the label and length
+ * @param data: const uint8_t*, data to authenticate
+ * @param len: size_t, length of data
+ * @param mac: uint8_t*, SESSION_TAG_SIZE bytes for the result
+ *
+ * @return int: negative if error, zero if successful
+*/
+static int session_simple_cbc_mac(const uint8_t* key, const uint8_t* first,
+                                  const uint8_t* data, size_t len, uint8_t* mac) {
+    uint8_t block[SESSION_BLOCK];
+
+    int error = aes_simple_ecb(key, MXC_AES_ENCRYPT_EXT_KEY, first, SESSION_BLOCK, mac);
+    for (size_t off = 0; error == E_NO_ERROR && off < len; off += SESSION_BLOCK) {
+        size_t count = len - off < SESSION_BLOCK ? len - off : SESSION_BLOCK;
+        memset(block, 0, SESSION_BLOCK);
+        memcpy(block, &data[off], count);
+        for (int i = 0; i < SESSION_BLOCK; i++) {
+            block[i] ^= mac[i];
+        }
+        error = aes_simple_ecb(key, MXC_AES_ENCRYPT_EXT_KEY, block, SESSION_BLOCK, mac);
+    }
+
+    crypto_zero(block, sizeof(block));
+    return error;
+}
+
+/**
+ * @brief Derive a key from two nonces
+ *
+ * @param key: const uint8_t*, SESSION_KEY_SIZE byte key to derive from
+ * @param label: uint8_t, purpose of the derived key
+ * @param x: const uint8_t*, first SESSION_NONCE_SIZE byte nonce
+ * @param y: const uint8_t*, second SESSION_NONCE_SIZE byte nonce
+ * @param out: uint8_t*, SESSION_KEY_SIZE bytes for the result
+ *
+ * @return int: negative if error, zero if successful
+*/
+static int session_simple_prf(const uint8_t* key, uint8_t label, const uint8_t* x,
+                              const uint8_t* y, uint8_t* out) {
+    uint8_t first[SESSION_BLOCK] = { label };
+    uint8_t data[2 * SESSION_NONCE_SIZE];
+
+    memcpy(data, x, SESSION_NONCE_SIZE);
+    memcpy(&data[SESSION_NONCE_SIZE], y, SESSION_NONCE_SIZE);
+    return session_simple_cbc_mac(key, first, data, sizeof(data), out);
+}
+
+/**
+ * @brief Derive the traffic keys and proof and open the session
+ *
+ * @param session: session_t*, session holding the master key
+ * @param nonce_ap: const uint8_t*, nonce sent by the AP
+ * @param nonce_comp: const uint8_t*, nonce sent by the component
+ *
+ * @return int: negative if error, zero if successful
+*/
+static int session_simple_derive(session_t* session, const uint8_t* nonce_ap,
+                                 const uint8_t* nonce_comp) {
+    int error = session_simple_prf(session->master, SESSION_LABEL_ENC,
+                                   nonce_ap, nonce_comp, session->enc_key);
+    if (error == E_NO_ERROR) {
+        error = session_simple_prf(session->master, SESSION_LABEL_MAC,
+                                   nonce_ap, nonce_comp, session->mac_key);
+    }
+    if (error == E_NO_ERROR) {
+        error = session_simple_prf(session->mac_key, SESSION_LABEL_PROOF,
+                                   nonce_ap, nonce_comp, session->proof);
+    }
+    if (error != E_NO_ERROR) {
+        session_simple_close(session);
+        return error;
+    }
+
+    session->send_seq = 0;
+    session->recv_seq = 0;
+    session->open = true;
+    return E_NO_ERROR;
+}
+
+/**
+ * @brief Compare two buffers in constant time
+ *
+ * @param a: const uint8_t*, first buffer
+ * @param b: const uint8_t*, second buffer
+ * @param len: size_t, number of bytes to compare
+ *
+ * @return bool: true if the buffers match
+*/
+static bool session_simple_equal(const uint8_t* a, const uint8_t* b, size_t len) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+/**
+ * @brief Fill the leading block of a record tag
+ *
+ * @param block: uint8_t*, SESSION_BLOCK bytes to fill
+ * @param dir: uint8_t, role of the sender
+ * @param seq: uint32_t, sequence number of the record
+ * @param len: uint8_t, length of the ciphertext
+*/
+static void session_simple_record_block(uint8_t* block, uint8_t dir, uint32_t seq, uint8_t len) {
+    memset(block, 0, SESSION_BLOCK);
+    block[0] = SESSION_LABEL_RECORD;
+    block[1] = dir;
+    for (int i = 0; i < SESSION_SEQ_SIZE; i++) {
+        block[2 + i] = seq >> (8 * (SESSION_SEQ_SIZE - 1 - i));
+    }
+    block[2 + SESSION_SEQ_SIZE] = len;
+}
+
+/**
+ * @brief Encrypt or decrypt a record payload in counter mode
+ *
+ * @param session: const session_t*, open session
+ * @param dir: uint8_t, role of the sender
+ * @param seq: uint32_t, sequence number of the record
+ * @param in: const uint8_t*, data to transform
+ * @param len: size_t, length of data
+ * @param out: uint8_t*, buffer for the result, may equal in
+ *
+ * @return int: negative if error, zero if successful
+ *
+ * Each counter block holds the sender, the sequence number and the
+ * block index, so no keystream is reused within a session
+*/
+static int session_simple_ctr(const session_t* session, uint8_t dir, uint32_t seq,
+                              const uint8_t* in, size_t len, uint8_t* out) {
+    uint8_t counter[SESSION_BLOCK] = { dir };
+
+    for (int i = 0; i < SESSION_SEQ_SIZE; i++) {
+        counter[1 + i] = seq >> (8 * (SESSION_SEQ_SIZE - 1 - i));
+    }
+    // Only the last byte counts blocks, a record is far shorter than 256 blocks
+    return aes_simple_ctr(session->enc_key, counter, 1, in, len, out);
+}
+
+/**
+ * @brief Take a handshake nonce from the random pool
+ *
+ * @param nonce: uint8_t*, SESSION_NONCE_SIZE bytes to fill
+ *
+ * @return int: negative if error, zero if successful
+ *
+ * Refills the pool once if it runs short
+*/
+int session_simple_nonce(uint8_t* nonce) {
+    if (random_simple_get(nonce, SESSION_NONCE_SIZE) == E_NO_ERROR) {
+        return E_NO_ERROR;
+    }
+    random_simple_service();
+    return random_simple_get(nonce, SESSION_NONCE_SIZE);
+}
+
+/**
+ * @brief Start a new session
+ *
+ * @param session: session_t*, session to initialize
+ * @param role: session_role_t, side of the link
+ * @param root: const uint8_t*, SESSION_KEY_SIZE byte deployment key
+ * @param nonce_ap: const uint8_t*, nonce sent by the AP
+ * @param nonce_comp: const uint8_t*, nonce sent by the component
+ *
+ * @return int: negative if error, zero if successful
+ *
+ * Derives the master key from the root key and both nonces, then the
+ * traffic keys and the proof, and opens the session with both
+ * sequence numbers at zero
+*/
+int session_simple_start(session_t* session, session_role_t role, const uint8_t* root,
+                         const uint8_t* nonce_ap, const uint8_t* nonce_comp) {
+    session_simple_close(session);
+    session->role = role;
+    memcpy(session->id, nonce_ap, SESSION_NONCE_SIZE);
+    memcpy(&session->id[SESSION_NONCE_SIZE], nonce_comp, SESSION_NONCE_SIZE);
+
+    int error = session_simple_prf(root, SESSION_LABEL_MASTER, nonce_ap, nonce_comp,
+                                   session->master);
+    if (error != E_NO_ERROR) {
+        session_simple_close(session);
+        return error;
+    }
+    return session_simple_derive(session, nonce_ap, nonce_comp);
+}
+
+/**
+ * @brief Rebuild the master key of a session from its ID
+ *
+ * @param session: session_t*, session to initialize
+ * @param role: session_role_t, side of the link
+ * @param root: const uint8_t*, SESSION_KEY_SIZE byte deployment key
+ * @param id: const uint8_t*, SESSION_ID_SIZE byte session ID
+ *
+ * @return int: negative if error, zero if successful
+ *
+ * Lets a component that lost its state accept a resumption. The session
+ * stays closed until session_simple_resume
+*/
+int session_simple_restore(session_t* session, session_role_t role, const uint8_t* root,
+                           const uint8_t* id) {
+    session_simple_close(session);
+    session->role = role;
+    memcpy(session->id, id, SESSION_ID_SIZE);
+
+    // The ID is the nonce pair the master key was first derived from
+    int error = session_simple_prf(root, SESSION_LABEL_MASTER, id, &id[SESSION_NONCE_SIZE],
+                                   session->master);
+    if (error != E_NO_ERROR) {
+        session_simple_close(session);
+    }
+    return error;
+}
+
+/**
+ * @brief Resume a session with fresh traffic keys
+ *
+ * @param session: session_t*, session holding the master key
+ * @param nonce_ap: const uint8_t*, nonce sent by the AP
+ * @param nonce_comp: const uint8_t*, nonce sent by the component
+ *
+ * @return int: negative if error, zero if successful
+ *
+ * Keeps the ID and master key, derives new traffic keys and proof from
+ * the nonces and restarts both sequence numbers at zero
+*/
+int session_simple_resume(session_t* session, const uint8_t* nonce_ap,
+                          const uint8_t* nonce_comp) {
+    session->open = false;
+    return session_simple_derive(session, nonce_ap, nonce_comp);
+}
+
+/**
+ * @brief Check the proof sent by the peer
+ *
+ * @param session: const session_t*, session being established
+ * @param proof: const uint8_t*, SESSION_TAG_SIZE bytes received
+ *
+ * @return bool: true if the peer derived the same keys
+*/
+bool session_simple_verify(const session_t* session, const uint8_t* proof) {
+    return session->open && session_simple_equal(session->proof, proof, SESSION_TAG_SIZE);
+}
+
+/**
+ * @brief Encrypt and authenticate a message
+ *
+ * @param session: session_t*, open session
+ * @param in: const uint8_t*, plaintext
+ * @param len: uint8_t, length of the plaintext, at most SESSION_MAX_PAYLOAD
+ * @param out: uint8_t*, buffer for the record, len + SESSION_OVERHEAD bytes
+ *
+ * @return int: length of the record, negative if error
+*/
+int session_simple_seal(session_t* session, const uint8_t* in, uint8_t len, uint8_t* out) {
+    uint8_t* ct = &out[SESSION_HEADER_SIZE];
+    return session_simple_sealv(session, in, len, out, ct, &ct[len]);
+}
+
+/**
+ * @brief Encrypt and authenticate a message into separate record parts
+ *
+ * @param session: session_t*, open session
+ * @param in: const uint8_t*, plaintext
+ * @param len: uint8_t, length of the plaintext, at most SESSION_MAX_PAYLOAD
+ * @param header: uint8_t*, SESSION_HEADER_SIZE bytes for the record header
+ * @param ct: uint8_t*, len bytes for the ciphertext
+ * @param tag: uint8_t*, SESSION_TAG_SIZE bytes for the tag
+ *
+ * @return int: length of the record, negative if error
+ *
+ * For gathered writes, the parts are sent back to back as one record
+*/
+int session_simple_sealv(session_t* session, const uint8_t* in, uint8_t len,
+                         uint8_t* header, uint8_t* ct, uint8_t* tag) {
+    uint8_t first[SESSION_BLOCK];
+
+    if (!session->open) {
+        return E_BAD_STATE;
+    }
+    if (len > SESSION_MAX_PAYLOAD) {
+        return E_BAD_PARAM;
+    }
+    // Never let the sequence number wrap onto a used keystream
+    if (session->send_seq == UINT32_MAX) {
+        return E_OVERFLOW;
+    }
+
+    uint8_t dir = session->role;
+    uint32_t seq = session->send_seq;
+
+    header[0] = SESSION_MSG_RECORD;
+    for (int i = 0; i < SESSION_SEQ_SIZE; i++) {
+        header[1 + i] = seq >> (8 * (SESSION_SEQ_SIZE - 1 - i));
+    }
+
+    int error = session_simple_ctr(session, dir, seq, in, len, ct);
+    if (error != E_NO_ERROR) {
+        return error;
+    }
+    session_simple_record_block(first, dir, seq, len);
+    error = session_simple_cbc_mac(session->mac_key, first, ct, len, tag);
+    if (error != E_NO_ERROR) {
+        return error;
+    }
+
+    session->send_seq++;
+    return len + SESSION_OVERHEAD;
+}
+
+/**
+ * @brief Authenticate and decrypt a record
+ *
+ * @param session: session_t*, open session
+ * @param in: const uint8_t*, record received
+ * @param len: int, length of the record
+ * @param out: uint8_t*, buffer for the plaintext
+ *
+ * @return int: length of the plaintext, negative if error
+ *
+ * Records must arrive in sequence. A record that is out of order or
+ * fails authentication is dropped and out is left untouched
+*/
+int session_simple_open(session_t* session, const uint8_t* in, int len, uint8_t* out) {
+    uint8_t first[SESSION_BLOCK];
+    uint8_t tag[SESSION_TAG_SIZE];
+
+    if (!session->open) {
+        return E_BAD_STATE;
+    }
+    if (len < SESSION_OVERHEAD || len > SESSION_RECORD_MAX || in[0] != SESSION_MSG_RECORD) {
+        return E_BAD_PARAM;
+    }
+
+    // Records come from the other side of the link
+    uint8_t dir = session->role == SESSION_ROLE_AP ? SESSION_ROLE_COMPONENT : SESSION_ROLE_AP;
+    uint32_t seq = 0;
+    for (int i = 0; i < SESSION_SEQ_SIZE; i++) {
+        seq = (seq << 8) | in[1 + i];
+    }
+    if (seq != session->recv_seq) {
+        return E_INVALID;
+    }
+
+    uint8_t ct_len = len - SESSION_OVERHEAD;
+    const uint8_t* ct = &in[SESSION_HEADER_SIZE];
+    session_simple_record_block(first, dir, seq, ct_len);
+    int error = session_simple_cbc_mac(session->mac_key, first, ct, ct_len, tag);
+    if (error != E_NO_ERROR) {
+        return error;
+    }
+    if (!session_simple_equal(tag, &ct[ct_len], SESSION_TAG_SIZE)) {
+        return E_INVALID;
+    }
+
+    error = session_simple_ctr(session, dir, seq, ct, ct_len, out);
+    if (error != E_NO_ERROR) {
+        return error;
+    }
+    session->recv_seq++;
+    return ct_len;
+}
+
+/**
+ * @brief Close a session and clear its keys
+ *
+ * @param session: session_t*, session to close
+*/
+void session_simple_close(session_t* session) {
+    crypto_zero(session, sizeof(session_t));
+}
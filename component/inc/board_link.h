@@ -21,6 +21,21 @@
 #define COMPONENT_ADDR_MASK 0x000000FF             
 #define SUCCESS_RETURN 0
 #define ERROR_RETURN -1
+// Answer SCAN and VALIDATE from the I2C ISR so the reply is ready
+// for the AP's first read. Set to 0 to handle every command in main
+#define BOARD_LINK_INLINE_REPLIES 1
+
+// Requests between wake latency reports printed by main in BENCHMARK builds
+#define BOARD_LINK_WAKE_REPORT_INTERVAL 64
+
+/******************************** TYPE DEFINITIONS ********************************/
+// Cycles from the ISR queuing a request to main picking it up after sleeping
+typedef struct {
+    uint32_t count;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+} wake_stats_t;
 
 /******************************** FUNCTION PROTOTYPES ********************************/
 
@@ -45,14 +60,38 @@ int board_link_init(i2c_addr_t addr);
 i2c_addr_t component_id_to_i2c_addr(uint32_t component_id);
 
 /**
- * @brief Send a packet to the AP and wait for ACK
+ * @brief Queue a reply packet for the AP
  * 
  * @param message: uint8_t*, message to be sent
  * 
  * This function utilizes the simple_i2c_peripheral library to
- * send a packet to the AP and wait for the message to be received
+ * queue a reply for the AP. The reply carries the sequence number of the
+ * last request received so the AP can match it. This only waits if every
+ * reply slot is still waiting to be acknowledged by the AP
+*/
+RAMFUNC void send_packet_and_ack(uint8_t len, uint8_t* packet);
+
+/**
+ * @brief Queue a constant reply packet for the AP
+ * 
+ * @param len: uint8_t, length of the packet
+ * @param packet: const uint8_t*, flash-resident packet to be sent
+ * 
+ * The ISR transmits the packet directly from flash. Only the first
+ * I2C_INLINE_LEN bytes are copied so they can be read with TRANSMIT_FRAME
+*/
+RAMFUNC void send_const_packet_and_ack(uint8_t len, const uint8_t* packet);
+
+/**
+ * @brief Point a reply slot at a constant reply
+ * 
+ * @param slot: volatile i2c_response_slot_t*, reply slot to fill
+ * @param len: uint8_t, length of the packet
+ * @param packet: const uint8_t*, flash-resident packet to be sent
+ * 
+ * Safe to call from an inline handler in the ISR
 */
-void send_packet_and_ack(uint8_t len, uint8_t* packet);
+RAMFUNC void stage_const_reply(volatile i2c_response_slot_t* slot, uint8_t len, const uint8_t* packet);
 
 /**
  * @brief Wait for a new message from AP and process the message
@@ -61,9 +100,16 @@ void send_packet_and_ack(uint8_t len, uint8_t* packet);
  * 
  * @return uint8_t: length of message received
  *
- * This function waits for a new message to be available from the AP,
+ * This function waits for the oldest queued request from the AP,
  * once the message is available it is returned in the buffer pointer to by packet 
 */
-uint8_t wait_and_receive_packet(uint8_t* packet);
+RAMFUNC uint8_t wait_and_receive_packet(uint8_t* packet);
+
+/**
+ * @brief Get the wake latency statistics
+ * 
+ * @return const wake_stats_t*: latency of every request main slept for
+*/
+const wake_stats_t* board_link_wake_stats(void);
 
 #endif
@@ -0,0 +1,31 @@
+/**
+ * @file "ramfunc.h"
+ * @brief SRAM-Resident Function Attribute Header
+ * @date 2024
+ *
+ * This source file is part of an example system for MITRE's 2024 Embedded System CTF (eCTF).
+ * This code is being provided only for educational purposes for the 2024 MITRE eCTF competition,
+ * and may not meet MITRE standards for quality. Use this code at your own risk!
+ *
+ * @copyright Copyright (c) 2024 The MITRE Corporation
+ */
+
+#ifndef __RAMFUNC__
+#define __RAMFUNC__
+
+/******************************** MACRO DEFINITIONS ********************************/
+// Run functions marked RAMFUNC from SRAM. Set to 0 to leave them in
+// flash, e.g. to compare timings
+#define RAMFUNC_MODE 1
+
+// Place a function in the .ramfunc section, which Reset_Handler copies
+// from flash to SRAM. SRAM is out of range of a direct branch from flash,
+// so calls go through a register. Mark the prototype as well as the
+// definition so callers in other files use the long call too
+#if RAMFUNC_MODE
+#define RAMFUNC __attribute__((section(".ramfunc"), long_call, noinline))
+#else
+#define RAMFUNC
+#endif
+
+#endif
@@ -23,21 +23,36 @@
 #include "board.h"
 #include "nvic_table.h"
 #include "i2c.h"
+#include "dma.h"
+#include "i2c_frame.h"
+#include "ramfunc.h"
 
 /******************************** MACRO DEFINITIONS ********************************/
 #define I2C_FREQ 100000
+// Fastest bus speed advertised to the AP in the scan reply
+#define I2C_MAX_SPEED I2C_SPEED_FAST_PLUS
 #define I2C_INTERFACE MXC_I2C1
-#define MAX_REG TRANSMIT_LEN
+// Move register payloads with DMA so the ISR only handles address match and STOP
+// Set to 0 to fall back to moving every byte through the FIFO threshold interrupts
+#define I2C_DMA_MODE 1
+#define MAX_REG TRANSMIT_FRAME
+#define I2C_REG_COUNT (MAX_REG + 1)
 #define MAX_I2C_MESSAGE_LEN 256
-
-/******************************** EXTERN DEFINITIONS ********************************/
-// Extern definition to make I2C_REGS and I2C_REGS_LEN 
-// accessible outside of the implementation
-extern volatile uint8_t* I2C_REGS[6];
-extern int I2C_REGS_LEN[6];
+// Requests the AP can queue ahead of the component and replies the
+// component can queue ahead of the AP. Each ring keeps one spare slot
+#define I2C_MAILBOX_DEPTH 4
+#define I2C_MAILBOX_NEXT(i) (((i) + 1) % (I2C_MAILBOX_DEPTH + 1))
+// Payload bytes of a constant reply readable through TRANSMIT_FRAME
+#define I2C_INLINE_LEN I2C_FRAME_INLINE_LEN
 
 /******************************** TYPE DEFINITIONS ********************************/
 // Enumeration with registers on the peripheral device
+// RECEIVE_FRAME takes an ack sequence, a request sequence and a length byte
+// followed by the payload in one write and queues it as if RECEIVE_LEN,
+// RECEIVE and RECEIVE_DONE were written. The commit also acknowledges every
+// queued reply up to and including the ack sequence
+// TRANSMIT_FRAME reads back TRANSMIT_DONE, the reply sequence, TRANSMIT_LEN
+// and TRANSMIT of the oldest queued reply in order
 typedef enum {
     RECEIVE,
     RECEIVE_DONE,
@@ -45,10 +60,69 @@ typedef enum {
     TRANSMIT,
     TRANSMIT_DONE,
     TRANSMIT_LEN,
+    RECEIVE_FRAME,
+    TRANSMIT_FRAME,
 } ECTF_I2C_REGS;
 
 typedef uint8_t i2c_addr_t;
 
+// Bus speeds a component can advertise in its scan reply
+typedef enum {
+    I2C_SPEED_STANDARD,
+    I2C_SPEED_FAST,
+    I2C_SPEED_FAST_PLUS,
+    I2C_SPEED_COUNT,
+} i2c_speed_t;
+
+// Request slot, filled by the ISR through the RECEIVE registers
+typedef struct {
+    uint8_t ack;
+    uint8_t seq;
+    uint8_t len;
+    uint8_t data[MAX_I2C_MESSAGE_LEN];
+} i2c_request_slot_t;
+
+// Reply slot, drained by the ISR through the TRANSMIT registers
+// A constant reply is sent from payload in flash, only its first
+// I2C_INLINE_LEN bytes are mirrored into data for TRANSMIT_FRAME reads
+typedef struct {
+    uint8_t done;
+    uint8_t seq;
+    uint8_t len;
+    uint8_t data[MAX_I2C_MESSAGE_LEN];
+    const uint8_t* payload;
+} i2c_response_slot_t;
+
+// Handler run from the ISR for a request that can be answered without main
+// Fills len, payload and data of reply and returns true, or returns false
+// to queue the request for main as usual
+typedef bool (*i2c_inline_handler_t)(volatile i2c_request_slot_t* request,
+                                     volatile i2c_response_slot_t* reply);
+
+/******************************** EXTERN DEFINITIONS ********************************/
+// Extern definition to make I2C_REGS and I2C_REGS_LEN 
+// accessible outside of the implementation
+extern volatile uint8_t* I2C_REGS[I2C_REG_COUNT];
+extern int I2C_REGS_LEN[I2C_REG_COUNT];
+
+// Mailbox rings. The ISR only advances I2C_REQUEST_HEAD and
+// I2C_RESPONSE_TAIL, main only advances I2C_REQUEST_TAIL and
+// I2C_RESPONSE_HEAD, so neither side needs a lock
+extern volatile i2c_request_slot_t I2C_REQUESTS[I2C_MAILBOX_DEPTH + 1];
+extern volatile i2c_response_slot_t I2C_RESPONSES[I2C_MAILBOX_DEPTH + 1];
+extern volatile uint8_t I2C_REQUEST_HEAD;
+extern volatile uint8_t I2C_REQUEST_TAIL;
+extern volatile uint8_t I2C_RESPONSE_HEAD;
+extern volatile uint8_t I2C_RESPONSE_TAIL;
+
+// Set by main while it waits for a request with no reply outstanding.
+// Requests are only answered from the ISR while this is set, so an inline
+// reply can never overtake one main still owes
+extern volatile bool I2C_REQUEST_WAITING;
+
+// Cycle counter when the ISR last queued a request for main
+extern volatile uint32_t I2C_REQUEST_CYCLES;
+
 /******************************** FUNCTION PROTOTYPES ********************************/
 /**
  * @brief Initialize the I2C Connection
@@ -62,4 +136,14 @@ typedef uint8_t i2c_addr_t;
 */
 int i2c_simple_peripheral_init(i2c_addr_t addr);
 
+/**
+ * @brief Set the handler for requests answered from the ISR
+ * 
+ * @param handler: i2c_inline_handler_t, handler to run, NULL to queue every request for main
+ *
+ * The reply is queued before STOP completes, so the controller's
+ * next read of TRANSMIT_FRAME returns it
+*/
+void i2c_simple_set_inline_handler(i2c_inline_handler_t handler);
+
 #endif
@@ -21,6 +21,10 @@ IPATH+=../deployment
 IPATH+=inc/
 VPATH+=src/
 
+# Modules shared by the application processor and the components
+IPATH+=../common/inc/
+VPATH+=../common/src/
+
 # ****************** eCTF Bootloader *******************
 # DO NOT REMOVE
 LINKERFILE=firmware.ld
@@ -40,3 +44,8 @@ CRYPTO_EXAMPLE=0
 
 # Enable Crypto Example
 #CRYPTO_EXAMPLE=1
+
+# ****************** Benchmarking *******************
+# Set BENCHMARK=1 to print wake latency and random pool statistics
+# every BOARD_LINK_WAKE_REPORT_INTERVAL requests
+BENCHMARK=0
@@ -15,6 +15,47 @@
 
 #include "board_link.h"
 
+/******************************** GLOBAL DEFINITIONS ********************************/
+// Sequence number of the last request received, echoed in the next reply
+static uint8_t request_seq = 0;
+
+// Latency from the ISR queuing a request to main dispatching it
+static wake_stats_t wake_stats = { .min_cycles = UINT32_MAX };
+
+/******************************** FUNCTION DEFINITIONS ********************************/
+/**
+ * @brief Wait for a free reply slot
+ * 
+ * @return volatile i2c_response_slot_t*: slot at the head of the reply ring
+ *
+ * This only waits if every reply slot is still waiting to be
+ * acknowledged by the AP
+*/
+static RAMFUNC volatile i2c_response_slot_t* reserve_reply_slot(void) {
+    // Sleep until the ISR releases a slot
+    while(I2C_MAILBOX_NEXT(I2C_RESPONSE_HEAD) == I2C_RESPONSE_TAIL) {
+        __WFE();
+    }
+
+    volatile i2c_response_slot_t* slot = &I2C_RESPONSES[I2C_RESPONSE_HEAD];
+    slot->seq = request_seq;
+    return slot;
+}
+
+/**
+ * @brief Hand a filled reply slot to the ISR
+ * 
+ * @param slot: volatile i2c_response_slot_t*, slot from reserve_reply_slot
+*/
+static RAMFUNC void queue_reply_slot(volatile i2c_response_slot_t* slot) {
+    // The AP may be reading this slot already if the ring was empty, so it
+    // must never see the reply as ready before it is queued
+    __disable_irq();
+    slot->done = false;
+    I2C_RESPONSE_HEAD = I2C_MAILBOX_NEXT(I2C_RESPONSE_HEAD);
+    __enable_irq();
+}
+
 /**
  * @brief Initialize the board link interface
  *
@@ -25,6 +66,11 @@
  * Initialized the underlying i2c_simple interface
 */
 int board_link_init(i2c_addr_t addr) {
+    // Cycle counter for wake latency
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
     return i2c_simple_peripheral_init(addr);
 }
 
@@ -40,21 +86,51 @@ i2c_addr_t component_id_to_i2c_addr(uint32_t component_id) {
 }
 
 /**
- * @brief Send a packet to the AP and wait for ACK
+ * @brief Queue a reply packet for the AP
  * 
  * @param message: uint8_t*, message to be sent
  * 
  * This function utilizes the simple_i2c_peripheral library to
- * send a packet to the AP and wait for the message to be received
+ * queue a reply for the AP. The reply carries the sequence number of the
+ * last request received so the AP can match it. This only waits if every
+ * reply slot is still waiting to be acknowledged by the AP
+*/
+RAMFUNC void send_packet_and_ack(uint8_t len, uint8_t* packet) {
+    volatile i2c_response_slot_t* slot = reserve_reply_slot();
+    slot->len = len;
+    slot->payload = NULL;
+    memcpy((void*)slot->data, (void*)packet, len);
+    queue_reply_slot(slot);
+}
+
+/**
+ * @brief Queue a constant reply packet for the AP
+ * 
+ * @param len: uint8_t, length of the packet
+ * @param packet: const uint8_t*, flash-resident packet to be sent
+ * 
+ * The ISR transmits the packet directly from flash. Only the first
+ * I2C_INLINE_LEN bytes are copied so they can be read with TRANSMIT_FRAME
 */
-void send_packet_and_ack(uint8_t len, uint8_t* packet) {
-    I2C_REGS[TRANSMIT_LEN][0] = len;
-    memcpy((void*)I2C_REGS[TRANSMIT], (void*)packet, len);
-    I2C_REGS[TRANSMIT_DONE][0] = false;
-
-    // Wait for ack from AP
-    while(!I2C_REGS[TRANSMIT_DONE][0]);
-    I2C_REGS[RECEIVE_DONE][0] = false;
+RAMFUNC void send_const_packet_and_ack(uint8_t len, const uint8_t* packet) {
+    volatile i2c_response_slot_t* slot = reserve_reply_slot();
+    stage_const_reply(slot, len, packet);
+    queue_reply_slot(slot);
+}
+
+/**
+ * @brief Point a reply slot at a constant reply
+ * 
+ * @param slot: volatile i2c_response_slot_t*, reply slot to fill
+ * @param len: uint8_t, length of the packet
+ * @param packet: const uint8_t*, flash-resident packet to be sent
+ * 
+ * Safe to call from an inline handler in the ISR
+*/
+RAMFUNC void stage_const_reply(volatile i2c_response_slot_t* slot, uint8_t len, const uint8_t* packet) {
+    slot->len = len;
+    slot->payload = packet;
+    memcpy((void*)slot->data, packet, len < I2C_INLINE_LEN ? len : I2C_INLINE_LEN);
 }
 
 /**
@@ -62,14 +138,48 @@ void send_packet_and_ack(uint8_t len, uint8_t* packet) {
  * 
  * @param packet: uint8_t*, message received
  * 
- * This function waits for a new message to be available from the AP,
+ * This function waits for the oldest queued request from the AP,
  * once the message is available it is returned in the buffer pointer to by packet 
 */
-uint8_t wait_and_receive_packet(uint8_t* packet) {
-    while(!I2C_REGS[RECEIVE_DONE][0]);
+RAMFUNC uint8_t wait_and_receive_packet(uint8_t* packet) {
+    // Every reply owed so far is queued, the ISR may answer on its own
+    I2C_REQUEST_WAITING = true;
+
+    // Sleep until the ISR queues a request. The ISR signals with SEV, which
+    // is latched, so an event between the check and WFE is not lost
+    bool slept = false;
+    while(I2C_REQUEST_TAIL == I2C_REQUEST_HEAD) {
+        __WFE();
+        slept = true;
+    }
+    I2C_REQUEST_WAITING = false;
 
-    uint8_t len = I2C_REGS[RECEIVE_LEN][0];
-    memcpy(packet, (void*)I2C_REGS[RECEIVE], len);
+    if (slept) {
+        uint32_t cycles = DWT->CYCCNT - I2C_REQUEST_CYCLES;
+        wake_stats.count++;
+        wake_stats.total_cycles += cycles;
+        if (cycles < wake_stats.min_cycles) {
+            wake_stats.min_cycles = cycles;
+        }
+        if (cycles > wake_stats.max_cycles) {
+            wake_stats.max_cycles = cycles;
+        }
+    }
+
+    volatile i2c_request_slot_t* slot = &I2C_REQUESTS[I2C_REQUEST_TAIL];
+    uint8_t len = slot->len;
+    memcpy(packet, (void*)slot->data, len);
+    request_seq = slot->seq;
+    I2C_REQUEST_TAIL = I2C_MAILBOX_NEXT(I2C_REQUEST_TAIL);
 
     return len;
 }
+
+/**
+ * @brief Get the wake latency statistics
+ * 
+ * @return const wake_stats_t*: latency of every request main slept for
+*/
+const wake_stats_t* board_link_wake_stats(void) {
+    return &wake_stats;
+}
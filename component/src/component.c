@@ -23,6 +23,8 @@
 
 #include "simple_i2c_peripheral.h"
 #include "board_link.h"
+#include "simple_random.h"
+#include "simple_session.h"
 
 // Includes from containerized build
 #include "ectf_params.h"
@@ -70,8 +72,36 @@ typedef struct {
 
 typedef struct {
     uint32_t component_id;
+    uint8_t max_speed;
 } scan_message;
 
+/********************************* CONSTANT REPLIES **********************************/
+// Replies that never change are built at compile time from ectf_params.h
+// and stay in flash, so the I2C ISR transmits them without a copy
+static const scan_message scan_reply = {
+    .component_id = COMPONENT_ID,
+    .max_speed = I2C_MAX_SPEED,
+};
+static const validate_message validate_reply = {
+    .component_id = COMPONENT_ID,
+};
+static const char boot_reply[] = COMPONENT_BOOT_MSG;
+static const char attest_reply[] = "LOC>" ATTESTATION_LOC "\nDATE>" ATTESTATION_DATE
+                                   "\nCUST>" ATTESTATION_CUSTOMER "\n";
+
+// Constant reply for each command
+typedef struct {
+    const void* data;
+    uint8_t len;
+} const_reply;
+
+static const const_reply reply_table[] = {
+    [COMPONENT_CMD_SCAN] = { &scan_reply, sizeof(scan_reply) },
+    [COMPONENT_CMD_VALIDATE] = { &validate_reply, sizeof(validate_reply) },
+    [COMPONENT_CMD_BOOT] = { boot_reply, sizeof(boot_reply) },
+    [COMPONENT_CMD_ATTEST] = { attest_reply, sizeof(attest_reply) },
+};
+
 /********************************* FUNCTION DECLARATIONS **********************************/
 // Core function definitions
 void component_process_cmd(void);
@@ -79,11 +109,18 @@ void process_boot(void);
 void process_scan(void);
 void process_validate(void);
 void process_attest(void);
+void process_hello(void);
+void process_resume(void);
 
 /********************************* GLOBAL VARIABLES **********************************/
 // Global varaibles
 uint8_t receive_buffer[MAX_I2C_MESSAGE_LEN];
 uint8_t transmit_buffer[MAX_I2C_MESSAGE_LEN];
+uint8_t receive_len;
+// Secure channel with the AP, opened before boot
+session_t session;
+// Deployment key every session is derived from
+static const uint8_t session_root[SESSION_KEY_SIZE] = SESSION_ROOT_KEY;
 
 /******************************* POST BOOT FUNCTIONALITY *********************************/
 /**
@@ -96,7 +133,13 @@ uint8_t transmit_buffer[MAX_I2C_MESSAGE_LEN];
  * This function must be implemented by your team to align with the security requirements.
 */
 void secure_send(uint8_t* buffer, uint8_t len) {
-    send_packet_and_ack(len, buffer); 
+    uint8_t record[MAX_I2C_MESSAGE_LEN];
+
+    int record_len = session_simple_seal(&session, buffer, len, record);
+    if (record_len < 0) {
+        return;
+    }
+    send_packet_and_ack(record_len, record); 
 }
 
 /**
@@ -110,7 +153,11 @@ void secure_send(uint8_t* buffer, uint8_t len) {
  * This function must be implemented by your team to align with the security requirements.
 */
 int secure_receive(uint8_t* buffer) {
-    return wait_and_receive_packet(buffer);
+    uint8_t record[MAX_I2C_MESSAGE_LEN];
+
+    uint8_t len = wait_and_receive_packet(record);
+    int result = session_simple_open(&session, record, len, buffer);
+    return result < 0 ? ERROR_RETURN : result;
 }
 
 /******************************* FUNCTION DEFINITIONS *********************************/
@@ -165,41 +212,126 @@ void component_process_cmd() {
     case COMPONENT_CMD_ATTEST:
         process_attest();
         break;
+    case SESSION_MSG_HELLO:
+        process_hello();
+        break;
+    case SESSION_MSG_RESUME:
+        process_resume();
+        break;
     default:
         printf("Error: Unrecognized command received %d\n", command->opcode);
         break;
     }
 }
 
+#if BOARD_LINK_INLINE_REPLIES
+/**
+ * @brief Answer SCAN and VALIDATE from the I2C ISR
+ * 
+ * @param request: volatile i2c_request_slot_t*, request just received
+ * @param reply: volatile i2c_response_slot_t*, reply slot to fill
+ * 
+ * @return bool: true if the reply was staged, false to leave the request for main
+*/
+static RAMFUNC bool inline_reply(volatile i2c_request_slot_t* request,
+                         volatile i2c_response_slot_t* reply) {
+    if (request->len < 1) {
+        return false;
+    }
+
+    uint8_t opcode = request->data[0];
+    if (opcode != COMPONENT_CMD_SCAN && opcode != COMPONENT_CMD_VALIDATE) {
+        return false;
+    }
+    stage_const_reply(reply, reply_table[opcode].len, reply_table[opcode].data);
+    return true;
+}
+#endif
+
+/**
+ * @brief Queue the constant reply for a command
+ * 
+ * @param cmd: component_cmd_t, command being answered
+*/
+static void send_const_reply(component_cmd_t cmd) {
+    send_const_packet_and_ack(reply_table[cmd].len, reply_table[cmd].data);
+}
+
 void process_boot() {
     // The AP requested a boot. Set `component_boot` for the main loop and
-    // respond with the boot message
-    uint8_t len = strlen(COMPONENT_BOOT_MSG) + 1;
-    memcpy((void*)transmit_buffer, COMPONENT_BOOT_MSG, len);
-    send_packet_and_ack(len, transmit_buffer);
+    // respond with the boot message. After boot every message belongs
+    // to the post boot code, so stop answering from the ISR
+    i2c_simple_set_inline_handler(NULL);
+    send_const_reply(COMPONENT_CMD_BOOT);
     // Call the boot function
     boot();
 }
 
 void process_scan() {
     // The AP requested a scan. Respond with the Component ID
-    scan_message* packet = (scan_message*) transmit_buffer;
-    packet->component_id = COMPONENT_ID;
-    send_packet_and_ack(sizeof(scan_message), transmit_buffer);
+    send_const_reply(COMPONENT_CMD_SCAN);
 }
 
 void process_validate() {
     // The AP requested a validation. Respond with the Component ID
-    validate_message* packet = (validate_message*) transmit_buffer;
-    packet->component_id = COMPONENT_ID;
-    send_packet_and_ack(sizeof(validate_message), transmit_buffer);
+    send_const_reply(COMPONENT_CMD_VALIDATE);
 }
 
 void process_attest() {
     // The AP requested attestation. Respond with the attestation data
-    uint8_t len = sprintf((char*)transmit_buffer, "LOC>%s\nDATE>%s\nCUST>%s\n",
-                ATTESTATION_LOC, ATTESTATION_DATE, ATTESTATION_CUSTOMER) + 1;
-    send_packet_and_ack(len, transmit_buffer);
+    send_const_reply(COMPONENT_CMD_ATTEST);
+}
+
+/**
+ * @brief Answer a HELLO or RESUME
+ * 
+ * @param type: uint8_t, message type being answered
+ * @param error: int, result of opening the session
+ *
+ * Replies with the component nonce already in transmit_buffer and the
+ * proof, or with the bare type so the AP fails fast
+*/
+static void send_session_reply(uint8_t type, int error) {
+    transmit_buffer[0] = type;
+    if (error != E_NO_ERROR) {
+        send_packet_and_ack(1, transmit_buffer);
+        return;
+    }
+    memcpy(&transmit_buffer[1 + SESSION_NONCE_SIZE], session.proof, SESSION_TAG_SIZE);
+    send_packet_and_ack(1 + SESSION_NONCE_SIZE + SESSION_TAG_SIZE, transmit_buffer);
+}
+
+void process_hello() {
+    // The AP started a new session. Derive it from both nonces and
+    // respond with the component nonce and the proof
+    uint8_t* nonce_comp = &transmit_buffer[1];
+    int error = E_BAD_PARAM;
+    if (receive_len == 1 + SESSION_NONCE_SIZE) {
+        error = session_simple_nonce(nonce_comp);
+    }
+    if (error == E_NO_ERROR) {
+        error = session_simple_start(&session, SESSION_ROLE_COMPONENT, session_root,
+                                     &receive_buffer[1], nonce_comp);
+    }
+    send_session_reply(SESSION_MSG_HELLO, error);
+}
+
+void process_resume() {
+    // The AP resumed a session, possibly one from before this component
+    // reset. Rebuild the master key from the ID and respond as for HELLO
+    uint8_t* nonce_comp = &transmit_buffer[1];
+    int error = E_BAD_PARAM;
+    if (receive_len == 1 + SESSION_ID_SIZE + SESSION_NONCE_SIZE) {
+        error = session_simple_nonce(nonce_comp);
+    }
+    if (error == E_NO_ERROR) {
+        error = session_simple_restore(&session, SESSION_ROLE_COMPONENT, session_root,
+                                       &receive_buffer[1]);
+    }
+    if (error == E_NO_ERROR) {
+        error = session_simple_resume(&session, &receive_buffer[1 + SESSION_ID_SIZE], nonce_comp);
+    }
+    send_session_reply(SESSION_MSG_RESUME, error);
 }
 
 /*********************************** MAIN *************************************/
@@ -213,12 +345,40 @@ int main(void) {
     // Initialize Component
     i2c_addr_t addr = component_id_to_i2c_addr(COMPONENT_ID);
     board_link_init(addr);
+    if (random_simple_init() != E_NO_ERROR) {
+        printf("Failed to seed random pool\n");
+    }
+#if BOARD_LINK_INLINE_REPLIES
+    i2c_simple_set_inline_handler(inline_reply);
+#endif
     
     LED_On(LED2);
 
+#if BENCHMARK
+    uint32_t wake_reported = 0;
+#endif
     while (1) {
-        wait_and_receive_packet(receive_buffer);
+        // Top up the random pool before waiting for the next request
+        random_simple_service();
+
+        receive_len = wait_and_receive_packet(receive_buffer);
 
         component_process_cmd();
+
+#if BENCHMARK
+        // Report how quickly main wakes for a request
+        const wake_stats_t* wake = board_link_wake_stats();
+        if (wake->count - wake_reported >= BOARD_LINK_WAKE_REPORT_INTERVAL) {
+            wake_reported = wake->count;
+            printf("Wake latency over %lu requests: min %lu, avg %lu, max %lu cycles\n",
+                   (unsigned long) wake->count, (unsigned long) wake->min_cycles,
+                   (unsigned long) (wake->total_cycles / wake->count),
+                   (unsigned long) wake->max_cycles);
+            const random_stats_t* random = random_simple_stats();
+            printf("Random pool: %lu bytes, %lu served, %lu stalls, %lu reseeds\n",
+                   (unsigned long) random->fill, (unsigned long) random->served,
+                   (unsigned long) random->stalls, (unsigned long) random->reseeds);
+        }
+#endif
     }
 }
@@ -13,37 +13,72 @@
 
 #include "simple_i2c_peripheral.h"
 
+#include <stddef.h>
+
 /******************************** GLOBAL DEFINITIONS ********************************/
-// Data for all of the I2C registers
-volatile uint8_t RECEIVE_REG[MAX_I2C_MESSAGE_LEN];
+// Mailbox rings backing the RECEIVE and TRANSMIT registers
+// In each slot the header bytes sit directly in front of the payload so a
+// RECEIVE_FRAME write or TRANSMIT_FRAME read covers them without a copy
+volatile i2c_request_slot_t I2C_REQUESTS[I2C_MAILBOX_DEPTH + 1];
+volatile i2c_response_slot_t I2C_RESPONSES[I2C_MAILBOX_DEPTH + 1];
+volatile uint8_t I2C_REQUEST_HEAD = 0;
+volatile uint8_t I2C_REQUEST_TAIL = 0;
+volatile uint8_t I2C_RESPONSE_HEAD = 0;
+volatile uint8_t I2C_RESPONSE_TAIL = 0;
+volatile bool I2C_REQUEST_WAITING = false;
+volatile uint32_t I2C_REQUEST_CYCLES = 0;
+
+// Handler for requests answered from the ISR, NULL if disabled
+static volatile i2c_inline_handler_t inline_handler = NULL;
+
+// Doorbell for the three-step RECEIVE_LEN, RECEIVE, RECEIVE_DONE sequence
 volatile uint8_t RECEIVE_DONE_REG[1];
-volatile uint8_t RECEIVE_LEN_REG[1];
-volatile uint8_t TRANSMIT_REG[MAX_I2C_MESSAGE_LEN];
-volatile uint8_t TRANSMIT_DONE_REG[1];
-volatile uint8_t TRANSMIT_LEN_REG[1];
 
 // Data structure to allow easy reference of I2C registers
-volatile uint8_t* I2C_REGS[6] = {
-    [RECEIVE] = RECEIVE_REG,
+// The RECEIVE registers map to the request slot being filled and the
+// TRANSMIT registers to the oldest queued reply, see i2c_simple_map_slots
+volatile uint8_t* I2C_REGS[I2C_REG_COUNT] = {
+    [RECEIVE] = I2C_REQUESTS[0].data,
     [RECEIVE_DONE] = RECEIVE_DONE_REG,
-    [RECEIVE_LEN] = RECEIVE_LEN_REG,
-    [TRANSMIT] = TRANSMIT_REG,
-    [TRANSMIT_DONE] = TRANSMIT_DONE_REG,
-    [TRANSMIT_LEN] = TRANSMIT_LEN_REG,
+    [RECEIVE_LEN] = &I2C_REQUESTS[0].len,
+    [TRANSMIT] = I2C_RESPONSES[0].data,
+    [TRANSMIT_DONE] = &I2C_RESPONSES[0].done,
+    [TRANSMIT_LEN] = &I2C_RESPONSES[0].len,
+    [RECEIVE_FRAME] = &I2C_REQUESTS[0].ack,
+    [TRANSMIT_FRAME] = &I2C_RESPONSES[0].done,
 };
 
 // Data structure to allow easy reference to I2C register length
-int I2C_REGS_LEN[6] = {
+int I2C_REGS_LEN[I2C_REG_COUNT] = {
     [RECEIVE] = MAX_I2C_MESSAGE_LEN,
     [RECEIVE_DONE] = 1,
     [RECEIVE_LEN] = 1,
     [TRANSMIT] = MAX_I2C_MESSAGE_LEN,
     [TRANSMIT_DONE] = 1,
     [TRANSMIT_LEN] = 1,
+    [RECEIVE_FRAME] = sizeof(i2c_request_slot_t),
+    [TRANSMIT_FRAME] = offsetof(i2c_response_slot_t, data) + MAX_I2C_MESSAGE_LEN,
 };
 
+#if I2C_DMA_MODE
+// DMA channels used to fill and drain the register buffers
+static int rx_dma_ch = -1;
+static int tx_dma_ch = -1;
+// RX FIFO threshold used while the register byte is still being received
+static unsigned int rx_thd_default;
+#endif
+
 /******************************** FUNCTION PROTOTYPES ********************************/
-static void i2c_simple_isr(void);
+static RAMFUNC void i2c_simple_isr(void);
+static RAMFUNC void i2c_simple_map_slots(void);
+static RAMFUNC void i2c_simple_commit_request(void);
+static RAMFUNC void i2c_simple_dispatch_request(void);
+static RAMFUNC void i2c_simple_pop_response(void);
+static RAMFUNC bool i2c_simple_writable(ECTF_I2C_REGS reg);
+#if I2C_DMA_MODE
+static RAMFUNC void i2c_simple_dma_start(int ch, mxc_dma_reqsel_t reqsel, volatile uint8_t* buf, int len);
+static RAMFUNC int i2c_simple_dma_stop(int ch);
+#endif
 
 /******************************** FUNCTION DEFINITIONS ********************************/
 /**
@@ -69,6 +104,22 @@ int i2c_simple_peripheral_init(uint8_t addr) {
     MXC_I2C_SetFrequency(I2C_INTERFACE, I2C_FREQ);
     MXC_I2C_ClearRXFIFO(I2C_INTERFACE);
 
+#if I2C_DMA_MODE
+    // Reserve one DMA channel per direction
+    error = MXC_DMA_Init();
+    if (error != E_NO_ERROR) {
+        printf("Failed to initialize DMA.\n");
+        return error;
+    }
+    rx_dma_ch = MXC_DMA_AcquireChannel();
+    tx_dma_ch = MXC_DMA_AcquireChannel();
+    if (rx_dma_ch < 0 || tx_dma_ch < 0) {
+        printf("Failed to acquire DMA channels.\n");
+        return E_NONE_AVAIL;
+    }
+    rx_thd_default = MXC_I2C_GetRXThreshold(I2C_INTERFACE);
+#endif
+
     // Enable interrupts and link ISR
     MXC_I2C_EnableInt(I2C_INTERFACE, MXC_F_I2C_INTFL0_RD_ADDR_MATCH, 0);
     MXC_I2C_EnableInt(I2C_INTERFACE, MXC_F_I2C_INTFL0_WR_ADDR_MATCH, 0);
@@ -78,37 +129,223 @@ int i2c_simple_peripheral_init(uint8_t addr) {
     MXC_I2C_ClearFlags(I2C_INTERFACE, 0xFFFFFFFF, 0xFFFFFFFF);
 
     // Prefix READY values for registers
+    for (int i = 0; i <= I2C_MAILBOX_DEPTH; i++) {
+        I2C_RESPONSES[i].done = true;
+    }
     I2C_REGS[RECEIVE_DONE][0] = false;
-    I2C_REGS[TRANSMIT_DONE][0] = true;
+    i2c_simple_map_slots();
 
     return E_NO_ERROR;
 }
 
+/**
+ * @brief Point the RECEIVE and TRANSMIT registers at the current slots
+ *
+ * RECEIVE, RECEIVE_LEN and RECEIVE_FRAME map to the request slot at the
+ * head of its ring, TRANSMIT, TRANSMIT_DONE, TRANSMIT_LEN and
+ * TRANSMIT_FRAME to the reply slot at the tail of its ring. TRANSMIT maps
+ * straight to the flash copy of a constant reply and is cut to its length
+*/
+static RAMFUNC void i2c_simple_map_slots(void) {
+    volatile i2c_request_slot_t* request = &I2C_REQUESTS[I2C_REQUEST_HEAD];
+    volatile i2c_response_slot_t* response = &I2C_RESPONSES[I2C_RESPONSE_TAIL];
+
+    I2C_REGS[RECEIVE] = request->data;
+    I2C_REGS[RECEIVE_LEN] = &request->len;
+    I2C_REGS[RECEIVE_FRAME] = &request->ack;
+    // A flash reply is only readable up to its length, the bytes after
+    // it belong to other constants
+    if (response->payload) {
+        I2C_REGS[TRANSMIT] = (volatile uint8_t*)response->payload;
+        I2C_REGS_LEN[TRANSMIT] = response->len;
+    } else {
+        I2C_REGS[TRANSMIT] = response->data;
+        I2C_REGS_LEN[TRANSMIT] = MAX_I2C_MESSAGE_LEN;
+    }
+    I2C_REGS[TRANSMIT_DONE] = &response->done;
+    I2C_REGS[TRANSMIT_LEN] = &response->len;
+    I2C_REGS[TRANSMIT_FRAME] = &response->done;
+}
+
+/**
+ * @brief Check whether the controller may write a register
+ * 
+ * @param reg: ECTF_I2C_REGS, register selected by the controller
+ * 
+ * @return bool: true if the register exists and is backed by RAM
+ *
+ * TRANSMIT maps to flash while a constant reply is queued
+*/
+static RAMFUNC bool i2c_simple_writable(ECTF_I2C_REGS reg) {
+    if (reg > MAX_REG) {
+        return false;
+    }
+    return !(reg == TRANSMIT && I2C_RESPONSES[I2C_RESPONSE_TAIL].payload != NULL);
+}
+
+/**
+ * @brief Queue the request slot that was just written
+ *
+ * Called from the ISR. If the ring is full the request is dropped and
+ * the same spare slot is reused by the next write. Signals an event so
+ * main wakes from WFE
+*/
+static RAMFUNC void i2c_simple_commit_request(void) {
+    uint8_t next = I2C_MAILBOX_NEXT(I2C_REQUEST_HEAD);
+    if (next == I2C_REQUEST_TAIL) {
+        return;
+    }
+    I2C_REQUEST_HEAD = next;
+    i2c_simple_map_slots();
+
+    // Wake main from WFE
+    I2C_REQUEST_CYCLES = DWT->CYCCNT;
+    __SEV();
+}
+
+/**
+ * @brief Set the handler for requests answered from the ISR
+ * 
+ * @param handler: i2c_inline_handler_t, handler to run, NULL to queue every request for main
+ *
+ * The reply is queued before STOP completes, so the controller's
+ * next read of TRANSMIT_FRAME returns it
+*/
+void i2c_simple_set_inline_handler(i2c_inline_handler_t handler) {
+    inline_handler = handler;
+}
+
+/**
+ * @brief Answer the request that was just written or queue it for main
+ *
+ * Called from the ISR. The inline handler only runs while main is waiting
+ * with nothing queued and a reply slot is free
+*/
+static RAMFUNC void i2c_simple_dispatch_request(void) {
+    i2c_inline_handler_t handler = inline_handler;
+    uint8_t next = I2C_MAILBOX_NEXT(I2C_RESPONSE_HEAD);
+
+    if (handler != NULL && I2C_REQUEST_WAITING &&
+        I2C_REQUEST_HEAD == I2C_REQUEST_TAIL && next != I2C_RESPONSE_TAIL) {
+        volatile i2c_request_slot_t* request = &I2C_REQUESTS[I2C_REQUEST_HEAD];
+        volatile i2c_response_slot_t* reply = &I2C_RESPONSES[I2C_RESPONSE_HEAD];
+        if (handler(request, reply)) {
+            reply->seq = request->seq;
+            reply->done = false;
+            I2C_RESPONSE_HEAD = next;
+            i2c_simple_map_slots();
+            return;
+        }
+    }
+
+    i2c_simple_commit_request();
+}
+
+/**
+ * @brief Release the oldest queued reply
+ *
+ * Called from the ISR once the AP has acknowledged the reply
+*/
+static RAMFUNC void i2c_simple_pop_response(void) {
+    if (I2C_RESPONSE_TAIL == I2C_RESPONSE_HEAD) {
+        return;
+    }
+    I2C_RESPONSES[I2C_RESPONSE_TAIL].done = true;
+    I2C_RESPONSE_TAIL = I2C_MAILBOX_NEXT(I2C_RESPONSE_TAIL);
+    i2c_simple_map_slots();
+
+    // Wake main if it is waiting for a free reply slot
+    __SEV();
+}
+
+#if I2C_DMA_MODE
+/**
+ * @brief Start a DMA transfer between the I2C FIFO and a register buffer
+ * 
+ * @param ch: int, the DMA channel to use
+ * @param reqsel: mxc_dma_reqsel_t, MXC_DMA_REQUEST_I2C1RX or MXC_DMA_REQUEST_I2C1TX
+ * @param buf: volatile uint8_t*, the register buffer to fill or drain
+ * @param len: int, number of bytes to move
+*/
+static RAMFUNC void i2c_simple_dma_start(int ch, mxc_dma_reqsel_t reqsel, volatile uint8_t* buf, int len) {
+    bool receive = (reqsel == MXC_DMA_REQUEST_I2C1RX);
+    mxc_dma_config_t config = {
+        .ch = ch,
+        .reqsel = reqsel,
+        .srcwd = MXC_DMA_WIDTH_BYTE,
+        .dstwd = MXC_DMA_WIDTH_BYTE,
+        .srcinc_en = !receive,
+        .dstinc_en = receive,
+    };
+    mxc_dma_srcdst_t srcdst = {
+        .ch = ch,
+        .source = receive ? NULL : (void*)buf,
+        .dest = receive ? (void*)buf : NULL,
+        .len = len,
+    };
+
+    MXC_DMA_ConfigChannel(config, srcdst);
+    MXC_DMA_Start(ch);
+}
+
+/**
+ * @brief Stop a DMA transfer started by i2c_simple_dma_start
+ * 
+ * @param ch: int, the DMA channel to stop
+ * 
+ * @return int: number of bytes the channel did not move
+*/
+static RAMFUNC int i2c_simple_dma_stop(int ch) {
+    MXC_DMA_Stop(ch);
+    return MXC_DMA->ch[ch].cnt;
+}
+#endif
+
 /**
  * @brief ISR for the I2C Peripheral
  * 
  * This ISR allows for a fully asynchronous interface between controller and peripheral
  * Transactions are able to begin immediately after a transaction ends
 */
-void i2c_simple_isr (void) {
+RAMFUNC void i2c_simple_isr (void) {
     // Variables for state of ISR
     static bool WRITE_START = false;
     static int READ_INDEX = 0;
     static int WRITE_INDEX = 0;
     static ECTF_I2C_REGS ACTIVE_REG = RECEIVE;
+#if I2C_DMA_MODE
+    // Bytes handed to each DMA channel for the current transaction
+    static int RX_DMA_LEN = 0;
+    static int TX_DMA_LEN = 0;
+#endif
 
     // Read interrupt flags
     uint32_t Flags = I2C_INTERFACE->intfl0;
     
     // Transaction over interrupt
     if (Flags & MXC_F_I2C_INTFL0_STOP) {
+
+#if I2C_DMA_MODE
+        // Account for what DMA moved, the FIFO drain below picks up the rest
+        if (RX_DMA_LEN > 0) {
+            WRITE_INDEX += RX_DMA_LEN - i2c_simple_dma_stop(rx_dma_ch);
+            I2C_INTERFACE->dma &= ~MXC_F_I2C_DMA_RX_EN;
+            MXC_I2C_SetRXThreshold(I2C_INTERFACE, rx_thd_default);
+            RX_DMA_LEN = 0;
+        }
+        if (TX_DMA_LEN > 0) {
+            i2c_simple_dma_stop(tx_dma_ch);
+            I2C_INTERFACE->dma &= ~MXC_F_I2C_DMA_TX_EN;
+            TX_DMA_LEN = 0;
+        }
+#endif
         
         // Ready any remaining data
         if (WRITE_START == true) {
             MXC_I2C_ReadRXFIFO(I2C_INTERFACE, (volatile unsigned char*) &ACTIVE_REG, 1);
             WRITE_START = false;
         }
-        if (ACTIVE_REG <= MAX_REG) {
+        if (i2c_simple_writable(ACTIVE_REG)) {
             int available = MXC_I2C_GetRXFIFOAvailable(I2C_INTERFACE);
             if (available < (I2C_REGS_LEN[ACTIVE_REG]-WRITE_INDEX)) {
                 WRITE_INDEX += MXC_I2C_ReadRXFIFO(I2C_INTERFACE,
@@ -124,6 +361,28 @@ void i2c_simple_isr (void) {
             MXC_I2C_ClearRXFIFO(I2C_INTERFACE);
         }
 
+        // Queue a complete framed write as a new request and release
+        // every reply the controller acknowledged with it
+        if (ACTIVE_REG == RECEIVE_FRAME && WRITE_INDEX >= 3) {
+            volatile i2c_request_slot_t* request = &I2C_REQUESTS[I2C_REQUEST_HEAD];
+            if (WRITE_INDEX >= request->len + 3) {
+                while (I2C_RESPONSE_TAIL != I2C_RESPONSE_HEAD &&
+                       (int8_t)(I2C_RESPONSES[I2C_RESPONSE_TAIL].seq - request->ack) <= 0) {
+                    i2c_simple_pop_response();
+                }
+                i2c_simple_dispatch_request();
+            }
+        }
+        // Three-step writes queue the request when RECEIVE_DONE is set
+        // and release one reply when TRANSMIT_DONE is set
+        else if (ACTIVE_REG == RECEIVE_DONE && WRITE_INDEX > 0 && RECEIVE_DONE_REG[0]) {
+            RECEIVE_DONE_REG[0] = false;
+            i2c_simple_dispatch_request();
+        }
+        else if (ACTIVE_REG == TRANSMIT_DONE && WRITE_INDEX > 0 && I2C_REGS[TRANSMIT_DONE][0]) {
+            i2c_simple_pop_response();
+        }
+
         // Disable bulk send/receive interrupts
         MXC_I2C_DisableInt(I2C_INTERFACE, MXC_F_I2C_INTEN0_RX_THD, 0);
         MXC_I2C_DisableInt(I2C_INTERFACE, MXC_F_I2C_INTEN0_TX_THD, 0);
@@ -178,14 +437,28 @@ void i2c_simple_isr (void) {
 
             // Select active register
             MXC_I2C_ReadRXFIFO(I2C_INTERFACE, (volatile unsigned char*) &ACTIVE_REG, 1);
+
+            // main may have queued a constant reply into the tail slot
+            // since it was mapped
+            i2c_simple_map_slots();
             
             // Write data to TX Buf
+#if I2C_DMA_MODE
+            // Let DMA feed the whole register into the FIFO
+            if (ACTIVE_REG <= MAX_REG && I2C_REGS_LEN[ACTIVE_REG] > 0) {
+                TX_DMA_LEN = I2C_REGS_LEN[ACTIVE_REG];
+                i2c_simple_dma_start(tx_dma_ch, MXC_DMA_REQUEST_I2C1TX,
+                    I2C_REGS[ACTIVE_REG], TX_DMA_LEN);
+                I2C_INTERFACE->dma |= MXC_F_I2C_DMA_TX_EN;
+            }
+#else
             if (ACTIVE_REG <= MAX_REG) {
                 READ_INDEX += MXC_I2C_WriteTXFIFO(I2C_INTERFACE, (volatile unsigned char*)I2C_REGS[ACTIVE_REG], I2C_REGS_LEN[ACTIVE_REG]);
                 if (READ_INDEX < I2C_REGS_LEN[ACTIVE_REG]) {
                     MXC_I2C_EnableInt(I2C_INTERFACE, MXC_F_I2C_INTEN0_TX_THD, 0);
                 }
             }
+#endif
         }
     }
 
@@ -202,14 +475,14 @@ void i2c_simple_isr (void) {
     }
 
     // RX Fifo Threshold Met on Write
-    if (Flags & MXC_F_I2C_INTEN0_RX_THD) {
+    if (Flags & MXC_F_I2C_INTEN0_RX_THD && (I2C_INTERFACE->inten0 & MXC_F_I2C_INTEN0_RX_THD)) {
         // We always write a register before writing data so select register
         if (WRITE_START == true) {
             MXC_I2C_ReadRXFIFO(I2C_INTERFACE, (volatile unsigned char*) &ACTIVE_REG, 1);
             WRITE_START = false;
         }
         // Read remaining data
-        if (ACTIVE_REG <= MAX_REG) {
+        if (i2c_simple_writable(ACTIVE_REG)) {
             int available = MXC_I2C_GetRXFIFOAvailable(I2C_INTERFACE);
             if (available < (I2C_REGS_LEN[ACTIVE_REG]-WRITE_INDEX)) {
                 WRITE_INDEX += MXC_I2C_ReadRXFIFO(I2C_INTERFACE,
@@ -226,6 +499,21 @@ void i2c_simple_isr (void) {
             MXC_I2C_ClearRXFIFO(I2C_INTERFACE);
         }
 
+#if I2C_DMA_MODE
+        // Once the register is known hand the rest of the write to DMA
+        // A single register byte never reaches the threshold, so the
+        // register of a write-then-read stays in the FIFO for the read match
+        if (i2c_simple_writable(ACTIVE_REG) && RX_DMA_LEN == 0 &&
+            WRITE_INDEX < I2C_REGS_LEN[ACTIVE_REG]) {
+            RX_DMA_LEN = I2C_REGS_LEN[ACTIVE_REG] - WRITE_INDEX;
+            MXC_I2C_DisableInt(I2C_INTERFACE, MXC_F_I2C_INTEN0_RX_THD, 0);
+            MXC_I2C_SetRXThreshold(I2C_INTERFACE, 1);
+            i2c_simple_dma_start(rx_dma_ch, MXC_DMA_REQUEST_I2C1RX,
+                &I2C_REGS[ACTIVE_REG][WRITE_INDEX], RX_DMA_LEN);
+            I2C_INTERFACE->dma |= MXC_F_I2C_DMA_RX_EN;
+        }
+#endif
+
         // Clear ISR flag
         MXC_I2C_ClearFlags(I2C_INTERFACE, MXC_F_I2C_INTFL0_RX_THD, 0);
     }